@@ -21,10 +21,7 @@ public:
 	// setColumns = true ==> sets the columns of the matrix to be [v0 v1 v2]
 	// otherwise, sets the rows
 	Matrix3f( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, bool setColumns = true );
-
-	Matrix3f( const Matrix3f& rm ); // copy constructor
-	Matrix3f& operator = ( const Matrix3f& rm ); // assignment operator
-	// no destructor necessary
+	// implicit copy, assignment and destructor keep the type trivially copyable
 
 	const float& operator () ( int i, int j ) const;
 	float& operator () ( int i, int j );
@@ -83,4 +80,201 @@ Vector3f operator * ( const Matrix3f& m, const Vector3f& v );
 // Matrix-Matrix multiplication
 Matrix3f operator * ( const Matrix3f& x, const Matrix3f& y );
 
+//////////////////////////////////////////////////////////////////////////
+// Inline
+//////////////////////////////////////////////////////////////////////////
+
+#include "Vector3f.h"
+
+inline Matrix3f::Matrix3f( float fill )
+{
+	for( int i = 0; i < 9; ++i )
+	{
+		m_elements[ i ] = fill;
+	}
+}
+
+inline Matrix3f::Matrix3f( float m00, float m01, float m02,
+				   float m10, float m11, float m12,
+				   float m20, float m21, float m22 )
+{
+	m_elements[ 0 ] = m00;
+	m_elements[ 1 ] = m10;
+	m_elements[ 2 ] = m20;
+
+	m_elements[ 3 ] = m01;
+	m_elements[ 4 ] = m11;
+	m_elements[ 5 ] = m21;
+
+	m_elements[ 6 ] = m02;
+	m_elements[ 7 ] = m12;
+	m_elements[ 8 ] = m22;
+}
+
+inline Matrix3f::Matrix3f( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, bool setColumns )
+{
+	if( setColumns )
+	{
+		setCol( 0, v0 );
+		setCol( 1, v1 );
+		setCol( 2, v2 );
+	}
+	else
+	{
+		setRow( 0, v0 );
+		setRow( 1, v1 );
+		setRow( 2, v2 );
+	}
+}
+
+inline const float& Matrix3f::operator () ( int i, int j ) const
+{
+	return m_elements[ j * 3 + i ];
+}
+
+inline float& Matrix3f::operator () ( int i, int j )
+{
+	return m_elements[ j * 3 + i ];
+}
+
+inline Vector3f Matrix3f::getRow( int i ) const
+{
+	return Vector3f
+	(
+		m_elements[ i ],
+		m_elements[ i + 3 ],
+		m_elements[ i + 6 ]
+	);
+}
+
+inline void Matrix3f::setRow( int i, const Vector3f& v )
+{
+	m_elements[ i ] = v.x();
+	m_elements[ i + 3 ] = v.y();
+	m_elements[ i + 6 ] = v.z();
+}
+
+inline Vector3f Matrix3f::getCol( int j ) const
+{
+	int colStart = 3 * j;
+
+	return Vector3f
+	(
+		m_elements[ colStart ],
+		m_elements[ colStart + 1 ],
+		m_elements[ colStart + 2 ]			
+	);
+}
+
+inline void Matrix3f::setCol( int j, const Vector3f& v )
+{
+	int colStart = 3 * j;
+
+	m_elements[ colStart ] = v.x();
+	m_elements[ colStart + 1 ] = v.y();
+	m_elements[ colStart + 2 ] = v.z();
+}
+
+inline float Matrix3f::determinant() const
+{
+	return Matrix3f::determinant3x3
+	(
+		m_elements[ 0 ], m_elements[ 3 ], m_elements[ 6 ],
+		m_elements[ 1 ], m_elements[ 4 ], m_elements[ 7 ],
+		m_elements[ 2 ], m_elements[ 5 ], m_elements[ 8 ]
+	);
+}
+
+inline void Matrix3f::transpose()
+{
+	float temp;
+
+	for( int i = 0; i < 2; ++i )
+	{
+		for( int j = i + 1; j < 3; ++j )
+		{
+			temp = ( *this )( i, j );
+			( *this )( i, j ) = ( *this )( j, i );
+			( *this )( j, i ) = temp;
+		}
+	}
+}
+
+inline Matrix3f Matrix3f::transposed() const
+{
+	Matrix3f out;
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			out( j, i ) = ( *this )( i, j );
+		}
+	}
+
+	return out;
+}
+
+inline Matrix3f::operator float* ()
+{
+	return m_elements;
+}
+
+// static
+inline float Matrix3f::determinant3x3( float m00, float m01, float m02,
+							   float m10, float m11, float m12,
+							   float m20, float m21, float m22 )
+{
+	return
+		(
+			  m00 * ( m11 * m22 - m12 * m21 )
+			- m01 * ( m10 * m22 - m12 * m20 )
+			+ m02 * ( m10 * m21 - m11 * m20 )
+		);
+}
+
+// static
+inline Matrix3f Matrix3f::identity()
+{
+	Matrix3f m;
+
+	m( 0, 0 ) = 1;
+	m( 1, 1 ) = 1;
+	m( 2, 2 ) = 1;
+
+	return m;
+}
+
+inline Vector3f operator * ( const Matrix3f& m, const Vector3f& v )
+{
+	Vector3f output( 0, 0, 0 );
+
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			output[ i ] += m( i, j ) * v[ j ];
+		}
+	}
+
+	return output;
+}
+
+inline Matrix3f operator * ( const Matrix3f& x, const Matrix3f& y )
+{
+	Matrix3f product; // zeroes
+
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			for( int k = 0; k < 3; ++k )
+			{
+				product( i, k ) += x( i, j ) * y( j, k );
+			}
+		}
+	}
+
+	return product;
+}
+
 #endif // MATRIX3F_H
@@ -13,16 +13,10 @@ public:
 	static const Vector2f UP;
 	static const Vector2f RIGHT;
 
-    Vector2f( float f = 0.f );
-    Vector2f( float x, float y );
+    constexpr Vector2f( float f = 0.f );
+    constexpr Vector2f( float x, float y );
 
-	// copy constructors
-    Vector2f( const Vector2f& rv );
-
-	// assignment operators
-	Vector2f& operator = ( const Vector2f& rv );
-
-	// no destructor necessary
+	// implicit copy, assignment and destructor keep the type trivially copyable
 
 	// returns the ith element
     const float& operator [] ( int i ) const;
@@ -31,8 +25,8 @@ public:
     float& x();
 	float& y();
 
-	float x() const;
-	float y() const;
+	constexpr float x() const;
+	constexpr float y() const;
 
     Vector2f xy() const;
 	Vector2f yx() const;
@@ -88,4 +82,208 @@ Vector2f operator / ( const Vector2f& v, float f );
 bool operator == ( const Vector2f& v0, const Vector2f& v1 );
 bool operator != ( const Vector2f& v0, const Vector2f& v1 );
 
+//////////////////////////////////////////////////////////////////////////
+// Inline
+//////////////////////////////////////////////////////////////////////////
+
+#include "Vector3f.h"
+
+constexpr Vector2f::Vector2f( float f ) :
+	m_elements{ f, f }
+{
+}
+
+constexpr Vector2f::Vector2f( float x, float y ) :
+	m_elements{ x, y }
+{
+}
+
+inline const float& Vector2f::operator [] ( int i ) const
+{
+    return m_elements[i];
+}
+
+inline float& Vector2f::operator [] ( int i )
+{
+    return m_elements[i];
+}
+
+inline float& Vector2f::x()
+{
+    return m_elements[0];
+}
+
+inline float& Vector2f::y()
+{
+    return m_elements[1];
+}
+
+constexpr float Vector2f::x() const
+{
+	return m_elements[0];
+}	
+
+constexpr float Vector2f::y() const
+{
+	return m_elements[1];
+}
+
+inline Vector2f Vector2f::xy() const
+{
+    return *this;
+}
+
+inline Vector2f Vector2f::yx() const
+{
+    return Vector2f( m_elements[1], m_elements[0] );
+}
+
+inline Vector2f Vector2f::xx() const
+{
+    return Vector2f( m_elements[0], m_elements[0] );
+}
+
+inline Vector2f Vector2f::yy() const
+{
+    return Vector2f( m_elements[1], m_elements[1] );
+}
+
+inline Vector2f Vector2f::normal() const
+{
+    return Vector2f( -m_elements[1], m_elements[0] );
+}
+
+inline float Vector2f::abs() const
+{
+    return sqrt(absSquared());
+}
+
+inline float Vector2f::absSquared() const
+{
+    return m_elements[0] * m_elements[0] + m_elements[1] * m_elements[1];
+}
+
+inline void Vector2f::normalize()
+{
+    float norm = abs();
+    m_elements[0] /= norm;
+    m_elements[1] /= norm;
+}
+
+inline Vector2f Vector2f::normalized() const
+{
+    float norm = abs();
+    return Vector2f( m_elements[0] / norm, m_elements[1] / norm );
+}
+
+inline void Vector2f::negate()
+{
+    m_elements[0] = -m_elements[0];
+    m_elements[1] = -m_elements[1];
+}
+
+inline Vector2f::operator const float* () const
+{
+    return m_elements;
+}
+
+inline Vector2f::operator float* ()
+{
+    return m_elements;
+}
+
+inline Vector2f& Vector2f::operator += ( const Vector2f& v )
+{
+	m_elements[ 0 ] += v.m_elements[ 0 ];
+	m_elements[ 1 ] += v.m_elements[ 1 ];
+	return *this;
+}
+
+inline Vector2f& Vector2f::operator -= ( const Vector2f& v )
+{
+	m_elements[ 0 ] -= v.m_elements[ 0 ];
+	m_elements[ 1 ] -= v.m_elements[ 1 ];
+	return *this;
+}
+
+inline Vector2f& Vector2f::operator *= ( float f )
+{
+	m_elements[ 0 ] *= f;
+	m_elements[ 1 ] *= f;
+	return *this;
+}
+
+// static
+inline float Vector2f::dot( const Vector2f& v0, const Vector2f& v1 )
+{
+    return v0[0] * v1[0] + v0[1] * v1[1];
+}
+
+// static
+inline Vector3f Vector2f::cross( const Vector2f& v0, const Vector2f& v1 )
+{
+	return Vector3f
+		(
+			0,
+			0,
+			v0.x() * v1.y() - v0.y() * v1.x()
+		);
+}
+
+// static
+inline Vector2f Vector2f::lerp( const Vector2f& v0, const Vector2f& v1, float alpha )
+{
+	return alpha * ( v1 - v0 ) + v0;
+}
+
+inline Vector2f operator + ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return Vector2f( v0.x() + v1.x(), v0.y() + v1.y() );
+}
+
+inline Vector2f operator - ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return Vector2f( v0.x() - v1.x(), v0.y() - v1.y() );
+}
+
+inline Vector2f operator * ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return Vector2f( v0.x() * v1.x(), v0.y() * v1.y() );
+}
+
+inline Vector2f operator / ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return Vector2f( v0.x() / v1.x(), v0.y() / v1.y() );
+}
+
+inline Vector2f operator - ( const Vector2f& v )
+{
+    return Vector2f( -v.x(), -v.y() );
+}
+
+inline Vector2f operator * ( float f, const Vector2f& v )
+{
+    return Vector2f( f * v.x(), f * v.y() );
+}
+
+inline Vector2f operator * ( const Vector2f& v, float f )
+{
+    return Vector2f( f * v.x(), f * v.y() );
+}
+
+inline Vector2f operator / ( const Vector2f& v, float f )
+{
+    return Vector2f( v.x() / f, v.y() / f );
+}
+
+inline bool operator == ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return( v0.x() == v1.x() && v0.y() == v1.y() );
+}
+
+inline bool operator != ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return !( v0 == v1 );
+}
+
 #endif // VECTOR_2F_H
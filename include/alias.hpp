@@ -0,0 +1,86 @@
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <vector>
+
+using namespace std;
+
+// Walker's alias method (Vose's construction): draws index i with
+// probability weights[i] / sum(weights) in constant time from one uniform.
+// Every column i keeps itself with probability threshold[i] and hands the
+// rest of its share to alias[i].
+class AliasTable {
+public:
+    AliasTable() {}
+
+    explicit AliasTable(const vector<float> &weights) {
+        build(weights);
+    }
+
+    // Falls back to a uniform choice when no weight is positive.
+    void build(const vector<float> &weights) {
+        int n = weights.size();
+        threshold.assign(n, 1);
+        alias.resize(n);
+        pdf.assign(n, n ? 1.0f / n : 0);
+        double sum = 0;
+        for (float weight : weights) {
+            sum += weight > 0 ? weight : 0;
+        }
+        for (int i = 0; i < n; ++i) {
+            alias[i] = i;
+        }
+        if (sum <= 0) {
+            return;
+        }
+        vector<double> scaled(n);
+        vector<int> small, large;
+        for (int i = 0; i < n; ++i) {
+            pdf[i] = weights[i] > 0 ? weights[i] / sum : 0;
+            scaled[i] = pdf[i] * n;
+            (scaled[i] < 1 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            int less = small.back(), more = large.back();
+            small.pop_back();
+            threshold[less] = scaled[less];
+            alias[less] = more;
+            scaled[more] -= 1 - scaled[less];
+            if (scaled[more] < 1) {
+                large.pop_back();
+                small.push_back(more);
+            }
+        }
+        // Whatever is left is a full column up to rounding.
+        for (int i : small) {
+            threshold[i] = 1;
+        }
+        for (int i : large) {
+            threshold[i] = 1;
+        }
+    }
+
+    // Index for a uniform u in [0, 1).
+    int sample(float u) const {
+        int n = threshold.size();
+        float column = u * n;
+        int i = (int)column;
+        i = i < n ? i : n - 1;
+        return column - i < threshold[i] ? i : alias[i];
+    }
+
+    float getPdf(int i) const {
+        return pdf[i];
+    }
+
+    int size() const {
+        return threshold.size();
+    }
+
+private:
+    vector<float> threshold;
+    vector<int> alias;
+    vector<float> pdf;
+};
+
+#endif
@@ -1,140 +1,606 @@
 #ifndef BVH_H
 #define BVH_H
 
-#include "triangle.hpp"
+#include "ray.hpp"
 #include "utils.hpp"
 #include "constant.hpp"
+#include "option.hpp"
+#include "profiler.hpp"
 #include <algorithm>
 #include <vector>
+#include <omp.h>
+#if defined(__SSE2__) && !defined(CHROMA_NO_SIMD)
+#include <emmintrin.h>
+#define CHROMA_SSE
+#endif
 
 using namespace std;
 
+// Nodes are stored in depth-first order: the first child of an interior
+// node follows it directly and only the second child's index is kept.
 class BVHNode {
 public:
-    Vector3f konta, makria;
-    BVHNode *lc, *rc;
-    int lo, hi;
-    BVHNode(): konta(1e100), makria(-1e100), lc(nullptr), rc(nullptr), lo(-1), hi(-1) {}
-    bool intersect(const Ray &ray, float tmax, float &t) {
-        Vector3f origin = ray.getOrigin(), direction = ray.getDirection();
-        Vector3f tKonta = (konta - origin) / direction, tMakria = (makria - origin) / direction;
-        float tEnter = Utils::max(Utils::min(tKonta, tMakria));
-        float tExit = Utils::min(Utils::max(tKonta, tMakria));
-        bool isIntersect = tEnter <= tExit && tExit >= 0 && tEnter < tmax;
-        t = isIntersect ? tEnter : 1e100;
-        return isIntersect;
+    float konta[3], makria[3];
+    int offset; // first primitive slot of a leaf, second child of an interior node
+    unsigned short count; // number of primitives, 0 for interior nodes
+    unsigned short axis; // split axis of an interior node
+    BVHNode(): konta{1e38, 1e38, 1e38}, makria{-1e38, -1e38, -1e38}, offset(-1), count(0), axis(0) {}
+    bool intersect(const float origin[3], const float invDirection[3], float tmax) const {
+        float tEnter = -1e38, tExit = 1e38;
+        for (int k = 0; k < 3; ++k) {
+            float tKonta = (konta[k] - origin[k]) * invDirection[k];
+            float tMakria = (makria[k] - origin[k]) * invDirection[k];
+            tEnter = max(tEnter, min(tKonta, tMakria));
+            tExit = min(tExit, max(tKonta, tMakria));
+        }
+        return tEnter <= tExit && tExit >= 0 && tEnter < tmax;
     }
 };
 
-class BVH {
+static_assert(sizeof(BVHNode) == 32, "BVHNode should fill half a cache line");
+
+// Four children per node, boxes in SoA form so one SSE slab test covers
+// all of them. A child is a node index, or ~(offset << 5 | count) for a leaf.
+class BVH4Node {
 public:
-    BVH(): root(nullptr), tria(nullptr) {}
-    void construct(vector<Triangle *> &patches) {
-        size = patches.size();
-        tria = new Object3D*[size];
+    float kontaX[4], kontaY[4], kontaZ[4];
+    float makriaX[4], makriaY[4], makriaZ[4];
+    int child[4];
+    int size;
+    BVH4Node(): size(0) {
+        for (int i = 0; i < 4; ++i) {
+            kontaX[i] = kontaY[i] = kontaZ[i] = 1e38;
+            makriaX[i] = makriaY[i] = makriaZ[i] = -1e38;
+            child[i] = ~0;
+        }
+    }
+    // Writes each child's entry distance to tEnter and returns a bit mask of the children hit.
+    int intersect(const float origin[3], const float invDirection[3], float tmax, float tEnter[4]) const {
+#ifdef CHROMA_SSE
+        __m128 ox = _mm_set1_ps(origin[0]), oy = _mm_set1_ps(origin[1]), oz = _mm_set1_ps(origin[2]);
+        __m128 ix = _mm_set1_ps(invDirection[0]), iy = _mm_set1_ps(invDirection[1]), iz = _mm_set1_ps(invDirection[2]);
+        __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(kontaX), ox), ix), x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(makriaX), ox), ix);
+        __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(kontaY), oy), iy), y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(makriaY), oy), iy);
+        __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(kontaZ), oz), iz), z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(makriaZ), oz), iz);
+        __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_min_ps(z0, z1));
+        __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_max_ps(z0, z1));
+        __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(enter, exit), _mm_cmpge_ps(exit, _mm_setzero_ps())), _mm_cmplt_ps(enter, _mm_set1_ps(tmax)));
+        _mm_storeu_ps(tEnter, enter);
+        return _mm_movemask_ps(hit) & ((1 << size) - 1);
+#else
+        const float *konta[3] = {kontaX, kontaY, kontaZ}, *makria[3] = {makriaX, makriaY, makriaZ};
+        int mask = 0;
         for (int i = 0; i < size; ++i) {
-            tria[i] = (Object3D *)patches[i];
+            float enter = -1e38, exit = 1e38;
+            for (int k = 0; k < 3; ++k) {
+                float t0 = (konta[k][i] - origin[k]) * invDirection[k];
+                float t1 = (makria[k][i] - origin[k]) * invDirection[k];
+                enter = max(enter, min(t0, t1));
+                exit = min(exit, max(t0, t1));
+            }
+            tEnter[i] = enter;
+            mask |= (enter <= exit && exit >= 0 && enter < tmax) << i;
+        }
+        return mask;
+#endif
+    }
+    // Returns the mask of the rays in `mask` that reach child i, and lowers
+    // nearest to the closest entry distance among them.
+    unsigned intersectPacket(int i, const RayPacket &packet, unsigned mask, float &nearest) const {
+        unsigned hits = 0;
+#ifdef CHROMA_SSE
+        __m128 kx = _mm_set1_ps(kontaX[i]), ky = _mm_set1_ps(kontaY[i]), kz = _mm_set1_ps(kontaZ[i]);
+        __m128 mx = _mm_set1_ps(makriaX[i]), my = _mm_set1_ps(makriaY[i]), mz = _mm_set1_ps(makriaZ[i]);
+        for (int j = 0; j < packet.size; j += 4) {
+            unsigned lanes = mask >> j & 15;
+            if (!lanes) {
+                continue;
+            }
+            __m128 ox = _mm_loadu_ps(packet.originX + j), oy = _mm_loadu_ps(packet.originY + j), oz = _mm_loadu_ps(packet.originZ + j);
+            __m128 ix = _mm_loadu_ps(packet.inverseX + j), iy = _mm_loadu_ps(packet.inverseY + j), iz = _mm_loadu_ps(packet.inverseZ + j);
+            __m128 x0 = _mm_mul_ps(_mm_sub_ps(kx, ox), ix), x1 = _mm_mul_ps(_mm_sub_ps(mx, ox), ix);
+            __m128 y0 = _mm_mul_ps(_mm_sub_ps(ky, oy), iy), y1 = _mm_mul_ps(_mm_sub_ps(my, oy), iy);
+            __m128 z0 = _mm_mul_ps(_mm_sub_ps(kz, oz), iz), z1 = _mm_mul_ps(_mm_sub_ps(mz, oz), iz);
+            __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_min_ps(z0, z1));
+            __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_max_ps(z0, z1));
+            __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(enter, exit), _mm_cmpge_ps(exit, _mm_setzero_ps())), _mm_cmplt_ps(enter, _mm_loadu_ps(packet.tmax + j)));
+            lanes &= _mm_movemask_ps(hit);
+            if (!lanes) {
+                continue;
+            }
+            float tEnter[4];
+            _mm_storeu_ps(tEnter, enter);
+            for (int k = 0; k < 4; ++k) {
+                if (lanes >> k & 1) {
+                    nearest = min(nearest, tEnter[k]);
+                }
+            }
+            hits |= lanes << j;
+        }
+#else
+        const float konta[3] = {kontaX[i], kontaY[i], kontaZ[i]}, makria[3] = {makriaX[i], makriaY[i], makriaZ[i]};
+        for (int j = 0; j < packet.size; ++j) {
+            if (!(mask >> j & 1)) {
+                continue;
+            }
+            const float origin[3] = {packet.originX[j], packet.originY[j], packet.originZ[j]};
+            const float invDirection[3] = {packet.inverseX[j], packet.inverseY[j], packet.inverseZ[j]};
+            float enter = -1e38, exit = 1e38;
+            for (int k = 0; k < 3; ++k) {
+                float t0 = (konta[k] - origin[k]) * invDirection[k];
+                float t1 = (makria[k] - origin[k]) * invDirection[k];
+                enter = max(enter, min(t0, t1));
+                exit = min(exit, max(t0, t1));
+            }
+            if (enter <= exit && exit >= 0 && enter < packet.tmax[j]) {
+                nearest = min(nearest, enter);
+                hits |= 1u << j;
+            }
+        }
+#endif
+        return hits;
+    }
+};
+
+class BVHBox {
+public:
+    float konta[3], makria[3];
+    BVHBox(): konta{1e38, 1e38, 1e38}, makria{-1e38, -1e38, -1e38} {}
+    BVHBox(const Vector3f &konta, const Vector3f &makria): konta{konta.x(), konta.y(), konta.z()}, makria{makria.x(), makria.y(), makria.z()} {}
+    void extend(const BVHBox &box) {
+        for (int k = 0; k < 3; ++k) {
+            konta[k] = min(konta[k], box.konta[k]);
+            makria[k] = max(makria[k], box.makria[k]);
+        }
+    }
+    // Twice the centroid, which orders and bins the same as the centroid.
+    float center(int k) const {
+        return konta[k] + makria[k];
+    }
+    void extendCenter(const BVHBox &box) {
+        for (int k = 0; k < 3; ++k) {
+            konta[k] = min(konta[k], box.center(k));
+            makria[k] = max(makria[k], box.center(k));
         }
-        root = construct(0, size);
     }
-    void construct(vector<Object3D *> &objects) {
-        size = objects.size();
-        tria = new Object3D*[size];
+    float surfaceArea() const {
+        float x = makria[0] - konta[0], y = makria[1] - konta[1], z = makria[2] - konta[2];
+        return x * y + y * z + z * x;
+    }
+};
+
+class BVH {
+public:
+    BVH(): size(0) {}
+    template <class Primitive>
+    void construct(vector<Primitive *> &primitives) {
+        vector<BVHBox> boxes(primitives.size());
+#pragma omp parallel for
+        for (int i = 0; i < (int)primitives.size(); ++i) {
+            boxes[i] = BVHBox(primitives[i]->konta, primitives[i]->makria);
+        }
+        construct(boxes);
+    }
+    void construct(vector<BVHBox> &primitiveBoxes) {
+        size = primitiveBoxes.size();
+        boxes.swap(primitiveBoxes);
+        order.resize(size);
         for (int i = 0; i < size; ++i) {
-            tria[i] = objects[i];
+            order[i] = i;
         }
-        root = construct(0, size);
+        nodes.clear();
+        wideNodes.clear();
+        if (size > 0) {
+            // Subtrees above taskCutoff primitives are built as OpenMP tasks.
+#pragma omp parallel
+#pragma omp single
+            construct(0, size, 0, nodes);
+            bounds = BVHBox();
+            for (int k = 0; k < 3; ++k) {
+                bounds.konta[k] = nodes[0].konta[k];
+                bounds.makria[k] = nodes[0].makria[k];
+            }
+            wideNodes.push_back(BVH4Node());
+            if (nodes[0].count > 0) {
+                setChild(wideNodes[0], 0, 0);
+            } else {
+                collapse(0, 0);
+            }
+        }
+        vector<BVHBox>().swap(boxes);
+        vector<BVHNode>().swap(nodes);
     }
-    bool intersect(const Ray &ray, Hit &hit, float tmin) {
-        float t;
-        return root->intersect(ray, hit.getT(), t) && intersect(root, ray, hit, tmin);
+    // Hands the leaf order to a caller that stores its primitives in that
+    // order, after which leaf slots index primitives directly.
+    vector<int> releaseOrder() {
+        vector<int> released;
+        released.swap(order);
+        return released;
     }
-    Vector3f getKonta() {
-        return root->konta;
+    // The built nodes, for storing them and loading them back without a
+    // rebuild. A loaded tree indexes primitives directly, as after
+    // releaseOrder().
+    const vector<BVH4Node> &getNodes() const {
+        return wideNodes;
     }
-    Vector3f getMakria() {
-        return root->makria;
+    const BVHBox &getBounds() const {
+        return bounds;
     }
-    ~BVH() {
-        if (root) {
-            destroy(root);
+    void load(const BVH4Node *first, int count, const BVHBox &box, int primitives) {
+        wideNodes.assign(first, first + count);
+        bounds = box;
+        size = primitives;
+        order.clear();
+    }
+    // Calls intersector(i) for every primitive i whose leaf the ray reaches,
+    // skipping subtrees beyond tmax, which the intersector lowers as it
+    // finds closer hits.
+    template <class Intersector>
+    bool intersect(const Ray &ray, const float &tmax, Intersector &&intersector) const {
+        if (wideNodes.empty()) {
+            return false;
+        }
+        const Vector3f &o = ray.getOrigin(), &d = ray.getDirection();
+        float origin[3] = {o.x(), o.y(), o.z()};
+        float invDirection[3] = {1 / d.x(), 1 / d.y(), 1 / d.z()};
+        bool isIntersect = false;
+        // Entries carry their entry distance, so subtrees that a closer hit
+        // has since ruled out are dropped when popped.
+        struct Entry {
+            int child;
+            float t;
+        } stack[stackSize];
+        int top = 0;
+        stack[top++] = {0, -1e38};
+        int visits = 0;
+        while (top > 0) {
+            Entry entry = stack[--top];
+            if (entry.t >= tmax) {
+                continue;
+            }
+            ++visits;
+            if (entry.child < 0) {
+                int leaf = ~entry.child, offset = leaf >> 5, count = leaf & 31;
+                for (int i = offset; i < offset + count; ++i) {
+                    isIntersect = intersector(order.empty() ? i : order[i]) || isIntersect;
+                }
+                continue;
+            }
+            const BVH4Node &node = wideNodes[entry.child];
+            float tEnter[4];
+            int mask = node.intersect(origin, invDirection, tmax, tEnter);
+            // Push the hit children far to near so the nearest is popped first.
+            int base = top;
+            for (int i = 0; i < 4; ++i) {
+                if (mask >> i & 1) {
+                    int j = top++;
+                    for (; j > base && stack[j - 1].t < tEnter[i]; --j) {
+                        stack[j] = stack[j - 1];
+                    }
+                    stack[j] = {node.child[i], tEnter[i]};
+                }
+            }
+        }
+        Profiler::count(Profiler::nodeVisits, visits);
+        return isIntersect;
+    }
+    // Packet form of intersect: a node is visited once for all the rays in
+    // mask that reach it, and intersector(i, mask) tests primitive i
+    // against the rays in mask, lowering packet.tmax as it finds closer
+    // hits and returning the mask of rays it hit.
+    template <class Intersector>
+    unsigned intersectPacket(RayPacket &packet, unsigned mask, Intersector &&intersector) const {
+        if (wideNodes.empty()) {
+            return 0;
         }
-        if (tria) {
-            for (int i = 0; i < size; ++i) {
-                tria[i] = nullptr;
+        unsigned hits = 0;
+        struct Entry {
+            int child;
+            unsigned mask;
+            float t;
+        } stack[stackSize];
+        int top = 0;
+        stack[top++] = {0, mask, -1e38};
+        int visits = 0;
+        while (top > 0) {
+            Entry entry = stack[--top];
+            // Drop the subtree once every ray in it has a closer hit.
+            float farthest = -1e38;
+            for (int j = 0; j < packet.size; ++j) {
+                if (entry.mask >> j & 1) {
+                    farthest = max(farthest, packet.tmax[j]);
+                }
+            }
+            if (entry.t >= farthest) {
+                continue;
+            }
+            ++visits;
+            if (entry.child < 0) {
+                int leaf = ~entry.child, offset = leaf >> 5, count = leaf & 31;
+                for (int i = offset; i < offset + count; ++i) {
+                    hits |= intersector(order.empty() ? i : order[i], entry.mask);
+                }
+                continue;
+            }
+            const BVH4Node &node = wideNodes[entry.child];
+            int base = top;
+            for (int i = 0; i < node.size; ++i) {
+                float nearest = 1e38;
+                unsigned mask = node.intersectPacket(i, packet, entry.mask, nearest);
+                if (mask) {
+                    int j = top++;
+                    for (; j > base && stack[j - 1].t < nearest; --j) {
+                        stack[j] = stack[j - 1];
+                    }
+                    stack[j] = {node.child[i], mask, nearest};
+                }
             }
-            delete[] tria;
         }
+        Profiler::count(Profiler::nodeVisits, visits);
+        return hits;
+    }
+    Vector3f getKonta() {
+        return Vector3f(bounds.konta[0], bounds.konta[1], bounds.konta[2]);
+    }
+    Vector3f getMakria() {
+        return Vector3f(bounds.makria[0], bounds.makria[1], bounds.makria[2]);
     }
 protected:
-    BVHNode *root;
-    Object3D **tria;
+    // Binary nodes only live during construction; traversal uses wideNodes.
+    vector<BVHNode> nodes;
+    vector<BVH4Node> wideNodes;
+    BVHBox bounds;
+    vector<int> order;
+    vector<BVHBox> boxes;
     int size;
-    BVHNode* construct(int lo, int hi) {
-        BVHNode *node = new BVHNode;
-        for (int i = lo; i < hi; ++i) {
-            node->konta = Utils::min(node->konta, tria[i]->konta);
-            node->makria = Utils::max(node->makria, tria[i]->makria);
-        }
-        if (hi - lo <= Constant::bvhmax) {
-            node->lo = lo;
-            node->hi = hi;
-            return node;
-        }
-        int mi = lo + hi >> 1;
-        Vector3f scale = node->makria - node->konta;
-        if (scale.x() > scale.y() && scale.x() > scale.z()) {
-            nth_element(tria + lo, tria + mi, tria + hi, [](Object3D *a, Object3D *b) {
-                return a->getCenter().x() < b->getCenter().x();
-            });
-        } else if (scale.y() > scale.z()) {
-            nth_element(tria + lo, tria + mi, tria + hi, [](Object3D *a, Object3D *b) {
-                return a->getCenter().y() < b->getCenter().y();
-            });
+    void setChild(BVH4Node &wide, int slot, int binary) {
+        const BVHNode &node = nodes[binary];
+        wide.kontaX[slot] = node.konta[0];
+        wide.kontaY[slot] = node.konta[1];
+        wide.kontaZ[slot] = node.konta[2];
+        wide.makriaX[slot] = node.makria[0];
+        wide.makriaY[slot] = node.makria[1];
+        wide.makriaZ[slot] = node.makria[2];
+        wide.child[slot] = ~(node.offset << 5 | node.count);
+        wide.size = max(wide.size, slot + 1);
+    }
+    // Fills wide node `wide` from interior binary node `binary`, pulling up
+    // grandchildren of the largest interior children until it has four.
+    void collapse(int wide, int binary) {
+        int children[4] = {binary + 1, nodes[binary].offset}, count = 2;
+        while (count < 4) {
+            int best = -1;
+            float bestArea = -1;
+            for (int i = 0; i < count; ++i) {
+                const BVHNode &node = nodes[children[i]];
+                float area = BVHBox(Vector3f(node.konta[0], node.konta[1], node.konta[2]), Vector3f(node.makria[0], node.makria[1], node.makria[2])).surfaceArea();
+                if (node.count == 0 && area > bestArea) {
+                    best = i;
+                    bestArea = area;
+                }
+            }
+            if (best < 0) {
+                break;
+            }
+            int expanded = children[best];
+            children[best] = expanded + 1;
+            children[count++] = nodes[expanded].offset;
+        }
+        for (int i = 0; i < count; ++i) {
+            setChild(wideNodes[wide], i, children[i]);
+            if (nodes[children[i]].count == 0) {
+                int index = wideNodes.size();
+                wideNodes[wide].child[i] = index;
+                wideNodes.push_back(BVH4Node());
+                collapse(index, children[i]);
+            }
+        }
+    }
+    int construct(int lo, int hi, int depth, vector<BVHNode> &out) {
+        int index = out.size();
+        out.push_back(BVHNode());
+        BVHBox box, centers;
+        bound(lo, hi, box, centers);
+        for (int k = 0; k < 3; ++k) {
+            out[index].konta[k] = box.konta[k];
+            out[index].makria[k] = box.makria[k];
+        }
+        int axis, mi;
+        if (Option::sah && depth < maxSAHDepth) {
+            if (!splitSAH(lo, hi, box, centers, axis, mi)) {
+                if (hi - lo <= Constant::bvhLeafMax) {
+                    out[index].offset = lo;
+                    out[index].count = hi - lo;
+                    return index;
+                }
+                splitMedian(lo, hi, centers, axis, mi);
+            }
         } else {
-            nth_element(tria + lo, tria + mi, tria + hi, [](Object3D *a, Object3D *b) {
-                return a->getCenter().z() < b->getCenter().z();
-            });
+            if (hi - lo <= Constant::bvhmax) {
+                out[index].offset = lo;
+                out[index].count = hi - lo;
+                return index;
+            }
+            splitMedian(lo, hi, centers, axis, mi);
+        }
+        out[index].axis = axis;
+        if (hi - lo < taskCutoff) {
+            construct(lo, mi, depth + 1, out);
+            int second = construct(mi, hi, depth + 1, out);
+            out[index].offset = second;
+            return index;
         }
-        node->lc = construct(lo, mi);
-        node->rc = construct(mi, hi);
-        return node;
+        vector<BVHNode> left, right;
+#pragma omp task shared(left)
+        construct(lo, mi, depth + 1, left);
+#pragma omp task shared(right)
+        construct(mi, hi, depth + 1, right);
+#pragma omp taskwait
+        splice(left, out);
+        int second = splice(right, out);
+        out[index].offset = second;
+        return index;
     }
-    void destroy(BVHNode *node) {
-        if (node->hi < 0) {
-            destroy(node->lc);
-            destroy(node->rc);
+    // Appends a subtree built on its own, rebasing its child links.
+    static int splice(const vector<BVHNode> &subtree, vector<BVHNode> &out) {
+        int base = out.size();
+        out.insert(out.end(), subtree.begin(), subtree.end());
+        for (int i = base; i < (int)out.size(); ++i) {
+            if (out[i].count == 0) {
+                out[i].offset += base;
+            }
         }
-        delete node;
+        return base;
     }
-    bool intersect(BVHNode *node, const Ray &ray, Hit &hit, float tmin) {
-        bool isIntersect = false;
-        if (node->hi < 0) {
-            float tl, tr;
-            bool aristera = node->lc->intersect(ray, hit.getT(), tl);
-            bool dexia = node->rc->intersect(ray, hit.getT(), tr);
-            if (tl <= tr) {
-                if (aristera) {
-                    isIntersect = intersect(node->lc, ray, hit, tmin) || isIntersect;
-                }
-                if (dexia) {
-                    isIntersect = intersect(node->rc, ray, hit, tmin) || isIntersect;
+    // Runs f(chunk, begin, end) over slices of [lo, hi), as tasks when the range is large.
+    static int chunkCount(int lo, int hi) {
+        return hi - lo < taskCutoff ? 1 : min(maxChunks, (hi - lo + taskCutoff - 1) / taskCutoff);
+    }
+    template <class F>
+    static int forChunks(int lo, int hi, F f) {
+        int chunks = chunkCount(lo, hi);
+        if (chunks == 1) {
+            f(0, lo, hi);
+            return 1;
+        }
+        for (int c = 0; c < chunks; ++c) {
+            int begin = lo + (long long)(hi - lo) * c / chunks, end = lo + (long long)(hi - lo) * (c + 1) / chunks;
+#pragma omp task firstprivate(c, begin, end) shared(f)
+            f(c, begin, end);
+        }
+#pragma omp taskwait
+        return chunks;
+    }
+    void bound(int lo, int hi, BVHBox &box, BVHBox &centers) {
+        if (chunkCount(lo, hi) == 1) {
+            for (int i = lo; i < hi; ++i) {
+                box.extend(boxes[order[i]]);
+                centers.extendCenter(boxes[order[i]]);
+            }
+            return;
+        }
+        BVHBox partBoxes[maxChunks], partCenters[maxChunks];
+        int chunks = forChunks(lo, hi, [&](int c, int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                partBoxes[c].extend(boxes[order[i]]);
+                partCenters[c].extendCenter(boxes[order[i]]);
+            }
+        });
+        for (int c = 0; c < chunks; ++c) {
+            box.extend(partBoxes[c]);
+            centers.extend(partCenters[c]);
+        }
+    }
+    // Stable partition through a scratch buffer, chunked so large ranges split in parallel.
+    template <class Predicate>
+    int partition(int lo, int hi, Predicate predicate) {
+        if (hi - lo < taskCutoff) {
+            return std::partition(order.begin() + lo, order.begin() + hi, predicate) - order.begin();
+        }
+        int counts[maxChunks + 1] = {0};
+        int chunks = forChunks(lo, hi, [&](int c, int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                counts[c + 1] += predicate(order[i]);
+            }
+        });
+        for (int c = 0; c < chunks; ++c) {
+            counts[c + 1] += counts[c];
+        }
+        int mi = lo + counts[chunks];
+        vector<int> scratch(hi - lo);
+        forChunks(lo, hi, [&](int c, int begin, int end) {
+            int left = counts[c], right = mi - lo + (begin - lo - counts[c]);
+            for (int i = begin; i < end; ++i) {
+                scratch[predicate(order[i]) ? left++ : right++] = order[i];
+            }
+        });
+        copy(scratch.begin(), scratch.end(), order.begin() + lo);
+        return mi;
+    }
+    void splitMedian(int lo, int hi, const BVHBox &centers, int &axis, int &mi) {
+        mi = (lo + hi) >> 1;
+        float x = centers.makria[0] - centers.konta[0], y = centers.makria[1] - centers.konta[1], z = centers.makria[2] - centers.konta[2];
+        axis = (x > y && x > z) ? 0 : (y > z ? 1 : 2);
+        nth_element(order.begin() + lo, order.begin() + mi, order.begin() + hi, [this, axis](int a, int b) {
+            return boxes[a].center(axis) < boxes[b].center(axis);
+        });
+    }
+    // Binned surface area heuristic. Returns false when a leaf is cheaper
+    // than any split, or when all centroids coincide.
+    bool splitSAH(int lo, int hi, const BVHBox &box, const BVHBox &centers, int &axis, int &mi) {
+        vector<int> counts(chunkCount(lo, hi) * 3 * bins, 0);
+        vector<BVHBox> binBoxes(chunkCount(lo, hi) * 3 * bins);
+        int chunks = forChunks(lo, hi, [&](int c, int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                const BVHBox &primitive = boxes[order[i]];
+                for (int k = 0; k < 3; ++k) {
+                    if (centers.makria[k] > centers.konta[k]) {
+                        int b = (c * 3 + k) * bins + bin(primitive, k, centers);
+                        ++counts[b];
+                        binBoxes[b].extend(primitive);
+                    }
                 }
-            } else {
-                if (dexia) {
-                    isIntersect = intersect(node->rc, ray, hit, tmin) || isIntersect;
+            }
+        });
+        for (int c = 1; c < chunks; ++c) {
+            for (int b = 0; b < 3 * bins; ++b) {
+                counts[b] += counts[c * 3 * bins + b];
+                binBoxes[b].extend(binBoxes[c * 3 * bins + b]);
+            }
+        }
+        float bestCost = 1e38, parentArea = box.surfaceArea();
+        int bestSplit = -1;
+        for (int k = 0; k < 3; ++k) {
+            if (!(centers.makria[k] > centers.konta[k])) {
+                continue;
+            }
+            const int *count = &counts[k * bins];
+            const BVHBox *binBox = &binBoxes[k * bins];
+            // rightCost[b] covers bins b..bins-1, swept from the right.
+            float rightCost[bins];
+            BVHBox sweep;
+            int sweepCount = 0;
+            for (int b = bins - 1; b > 0; --b) {
+                sweep.extend(binBox[b]);
+                sweepCount += count[b];
+                rightCost[b] = sweepCount ? sweepCount * sweep.surfaceArea() : -1;
+            }
+            sweep = BVHBox();
+            sweepCount = 0;
+            for (int b = 1; b < bins; ++b) {
+                sweep.extend(binBox[b - 1]);
+                sweepCount += count[b - 1];
+                if (sweepCount == 0 || rightCost[b] < 0) {
+                    continue;
                 }
-                if (aristera) {
-                    isIntersect = intersect(node->lc, ray, hit, tmin) || isIntersect;
+                float cost = Constant::bvhTraversalCost + (sweepCount * sweep.surfaceArea() + rightCost[b]) / parentArea;
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = b;
+                    axis = k;
                 }
             }
-        } else {
-            for (int i = node->lo; i < node->hi; ++i) {
-                isIntersect = tria[i]->intersect(ray, hit, tmin) || isIntersect;
-            }
         }
-        return isIntersect;
+        if (bestSplit < 0 || bestCost >= hi - lo) {
+            return false;
+        }
+        int k = axis;
+        mi = partition(lo, hi, [&](int i) {
+            return bin(boxes[i], k, centers) < bestSplit;
+        });
+        return true;
+    }
+    static int bin(const BVHBox &primitive, int axis, const BVHBox &centers) {
+        int b = bins * ((primitive.center(axis) - centers.konta[axis]) / (centers.makria[axis] - centers.konta[axis]));
+        return b < bins ? b : bins - 1;
     }
+    static const int bins = 16;
+    static const int taskCutoff = 4096;
+    static const int maxChunks = 64;
+    // Past this depth the builder falls back to median splits, which keeps
+    // the tree within the traversal stack.
+    static const int maxSAHDepth = 32;
+    static const int stackSize = 3 * 64 + 4;
 };
 
-#endif
\ No newline at end of file
+#endif
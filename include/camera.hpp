@@ -27,6 +27,11 @@ public:
 
     int getWidth() const { return width; }
     int getHeight() const { return height; }
+    const Vector3f &getCenter() const { return center; }
+    // Width of one pixel seen at unit distance from the camera.
+    virtual float getPixelSpread() const = 0;
+    // Whether rays leave from across an aperture rather than one point.
+    virtual bool hasDepthOfField() const = 0;
 
 protected:
     // Extrinsic parameters
@@ -63,6 +68,14 @@ public:
         return Ray(center + horizontal * sampleX - up * sampleY, rotate * Vector3f((point.x() * pixelX - halfLengthX) * disToFocalPlane - sampleX, (halfLengthY - point.y() * pixelY) * disToFocalPlane - sampleY, disToFocalPlane).normalized(), Utils::randomEngine(tStart, tEnd));
     }
 
+    float getPixelSpread() const override {
+        return pixelY;
+    }
+
+    bool hasDepthOfField() const override {
+        return apertureRadius > 0;
+    }
+
     Ray generateAverageRay(const Vector2f &point) override {
         // Add a (-1, 1) random interrupt to the ray.
         return generateRay(Vector2f(point.x() + Utils::randomEngine(-1, 1), point.y() + Utils::randomEngine(-1, 1)));
@@ -1,6 +1,7 @@
 #ifndef CHROMA_H
 #define CHROMA_H
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
@@ -14,8 +15,10 @@
 #include "image.hpp"
 #include "camera.hpp"
 #include "group.hpp"
+#include "hash_grid.hpp"
 #include "kdtree.hpp"
 #include "light.hpp"
+#include "profiler.hpp"
 #include <omp.h>
 #include "constant.hpp"
 #include "utils.hpp"
@@ -24,10 +27,102 @@ using namespace std;
 
 class Chroma {
 public:
-    Chroma(SceneParser &sceneParser, Image &image): kdtree(image), camera(sceneParser.getCamera()), backgroundColor(sceneParser.getBackgroundColor()), baseGroup(sceneParser.getGroup()), image(image) {
+    Chroma(SceneParser &sceneParser, Image &image): photonMap(Option::hashGrid ? (PhotonMap *)new HashGrid(image) : new KDTree(image)), camera(sceneParser.getCamera()), backgroundColor(sceneParser.getBackgroundColor()), baseGroup(sceneParser.getGroup()), image(image) {
         baseGroup->activate();
+        // Starved pixels widen their radius up to a fraction of the scene size.
+        float diagonal = (baseGroup->makria - baseGroup->konta).length();
+        maxRadius = std::isfinite(diagonal) && diagonal > 0 ? Constant::maxRadiusFraction * diagonal : 0;
+        if (maxRadius > 0) {
+            Pixel::maxSquaredRadius = maxRadius * maxRadius;
+        }
+        orderTiles(Option::tileOrder);
+        // Deposits are keyed by a 1024^3 lattice over the scene bounds.
+        for (int k = 0; k < 3; ++k) {
+            float extent = baseGroup->makria[k] - baseGroup->konta[k];
+            depositScale[k] = std::isfinite(extent) && extent > 0 ? 1023 / extent : 0;
+        }
+    }
+    // Closest hit of a ray, shaded. Rays are counted here and at the packet
+    // calls, once each, however deep the groups they go through.
+    bool intersect(const Ray &ray, Hit &hit) const {
+        Profiler::count(Profiler::rays);
+        if (!baseGroup->intersect(ray, hit, Constant::tmin)) {
+            return false;
+        }
+        hit.computeSurfaceInteraction(ray);
+        return true;
+    }
+    // What a surface does to a photon, drawn from its material. A photon
+    // that draws past every kind carries on unchanged.
+    enum Bounce {
+        diffuseBounce,
+        specularBounce,
+        refractBounce,
+        passBounce,
+        absorbedBounce
+    };
+    static Bounce chooseBounce(const Hit &hit) {
+        float erabu = Utils::randomEngine();
+        float genkai = hit.getMaterial()->getDiffuse();
+        if (erabu < genkai) {
+            return diffuseBounce;
+        }
+        genkai += hit.getMaterial()->getSpecular();
+        if (erabu < genkai) {
+            return specularBounce;
+        }
+        genkai += hit.getMaterial()->getRefract();
+        return erabu < genkai ? refractBounce : passBounce;
+    }
+    // Sends the beam on from the surface it hit.
+    static void scatter(Ray &beam, const Hit &hit, Bounce bounce) {
+        float dotProduct = Vector3f::dot(beam.getDirection(), hit.getNormal());
+        bool into = dotProduct < 0;
+        Vector3f hitPoint = beam.pointAtParameter(hit.getT());
+        if (bounce == diffuseBounce) {
+            Vector3f diffuseReflectDirection = Utils::sampleReflectedRay((into ? 1 : -1) * hit.getNormal());
+            beam.set(hitPoint, diffuseReflectDirection);
+            return;
+        }
+        Vector3f reflectDirection = beam.getDirection() - 2 * dotProduct * hit.getNormal();
+        if (bounce == specularBounce) {
+            beam.set(hitPoint, reflectDirection);
+            return;
+        }
+        if (bounce != refractBounce) {
+            return;
+        }
+        float refr = into ? hit.getMaterial()->getRefr() : 1 / hit.getMaterial()->getRefr();
+        float incidentAngleCosine = into ? -dotProduct : dotProduct, squaredRefractAngleCosine = 1 - (1 - Utils::square(incidentAngleCosine)) / Utils::square(refr);
+        if (squaredRefractAngleCosine > 0) {
+            float refractAngleCosine = sqrt(squaredRefractAngleCosine);
+            // Schlick's approximation for Fresnel term.
+            float R0 = Utils::square((refr - 1) / (refr + 1));
+            float outerAngleCosine = into ? incidentAngleCosine : refractAngleCosine;
+            float R = R0 + (1 - R0) * pow(1 - outerAngleCosine, 5);
+            // R represents the reflect rate.
+            if (Utils::randomEngine() <= R) {
+                // Reflection
+                beam.set(hitPoint, reflectDirection);
+            } else {
+                // Refraction
+                Vector3f refractDirection = (beam.getDirection() / refr + hit.getNormal() * ((into ? 1 : -1) * (incidentAngleCosine / refr - refractAngleCosine))).normalized();
+                beam.set(hitPoint, refractDirection);
+            }
+        } else { // Total reflection
+            beam.set(hitPoint, reflectDirection);
+        }
+    }
+    PhotonDeposit makeDeposit(const Vector3f &position, const Vector3f &accumulate) const {
+        uint32_t cell[3];
+        for (int k = 0; k < 3; ++k) {
+            cell[k] = min(1023.0f, max(0.0f, (position[k] - baseGroup->konta[k]) * depositScale[k]));
+        }
+        return {Utils::morton(cell[0], cell[1], cell[2]), position, accumulate};
     }
-    void photonTrace(Ray beam, Vector3f accumulate) {
+    // Diffuse hits go to the thread's batch, which is applied to the photon
+    // map whenever it fills up.
+    void photonTrace(Ray beam, Vector3f accumulate, vector<PhotonDeposit> &batch) {
         for (int depth = 0; depth < Constant::traceThreshold; ++depth) {
             if (depth > Constant::russianRoulette) {
                 float maxAccumulate = Utils::max(accumulate);
@@ -38,61 +133,29 @@ public:
                 }
             }
             Hit hit;
-            if (!baseGroup->intersect(beam, hit, Constant::tmin)) {
+            if (!intersect(beam, hit)) {
                 return;
             }
             accumulate *= hit.getColor();
-            float dotProduct = Vector3f::dot(beam.getDirection(), hit.getNormal());
-            bool into = dotProduct < 0;
-            Vector3f hitPoint = beam.pointAtParameter(hit.getT());
-
-            float erabu = Utils::randomEngine();
-            float genkai = hit.getMaterial()->getDiffuse();
-            if (erabu < genkai) {
-                kdtree.update(hitPoint, accumulate);
-                Vector3f diffuseReflectDirection = Utils::sampleReflectedRay((into ? 1 : -1) * hit.getNormal());
-                beam.set(hitPoint, diffuseReflectDirection);
-                continue;
-            }
-
-            Vector3f reflectDirection = beam.getDirection() - 2 * dotProduct * hit.getNormal();
-
-            genkai += hit.getMaterial()->getSpecular();
-            if (erabu < genkai) {
-                beam.set(hitPoint, reflectDirection);
-                continue;
-            }
-
-            genkai += hit.getMaterial()->getRefract();
-            if (erabu < genkai) {
-                float refr = into ? hit.getMaterial()->getRefr() : 1 / hit.getMaterial()->getRefr();
-                float incidentAngleCosine = into ? -dotProduct : dotProduct, squaredRefractAngleCosine = 1 - (1 - Utils::square(incidentAngleCosine)) / Utils::square(refr);
-                if (squaredRefractAngleCosine > 0) {
-                    float refractAngleCosine = sqrt(squaredRefractAngleCosine);
-                    // Schlick's approximation for Fresnel term.
-                    float R0 = Utils::square((refr - 1) / (refr + 1));
-                    float outerAngleCosine = into ? incidentAngleCosine : refractAngleCosine;
-                    float R = R0 + (1 - R0) * pow(1 - outerAngleCosine, 5);
-                    // R represents the reflect rate.
-                    if (Utils::randomEngine() <= R) {
-                        // Reflection
-                        beam.set(hitPoint, reflectDirection);
-                    } else {
-                        // Refraction
-                        Vector3f refractDirection = (beam.getDirection() / refr + hit.getNormal() * ((into ? 1 : -1) * (incidentAngleCosine / refr - refractAngleCosine))).normalized();
-                        beam.set(hitPoint, refractDirection);
-                    }
-                } else { // Total reflection
-                    beam.set(hitPoint, reflectDirection);
+            Bounce bounce = chooseBounce(hit);
+            if (bounce == diffuseBounce) {
+                batch.push_back(makeDeposit(beam.pointAtParameter(hit.getT()), accumulate));
+                if ((int)batch.size() >= Constant::depositBatch) {
+                    photonMap->update(batch);
                 }
             }
+            scatter(beam, hit, bounce);
         }
     }
-    void rayTrace(Pixel &pixel, Ray ray) {
+    // Follows an eye ray to its visible point. A primary hit found ahead of
+    // time, by a packet, stands in for the first intersection.
+    void rayTrace(Pixel &pixel, Ray ray, const Hit *primary = nullptr) {
         Vector3f accumulate(1);
         for (int depth = 0; depth < Constant::traceThreshold; ++depth) {
-            Hit hit;
-            if (!baseGroup->intersect(ray, hit, Constant::tmin)) {
+            Hit traced;
+            bool given = depth == 0 && primary;
+            const Hit &hit = given ? *primary : traced;
+            if (given ? hit.getT() >= 1e38 : !intersect(ray, traced)) {
                 pixel.phos += pixel.accumulate * backgroundColor;
                 pixel.hitPoint = ray.pointAtParameter(1e100);
                 return;
@@ -147,76 +210,455 @@ public:
         pixel.phos += pixel.accumulate * backgroundColor;
         pixel.hitPoint = ray.pointAtParameter(1e100);
     }
+    // Starts every pixel with a radius of a few pixel footprints at the
+    // distance of its first visible point, capped by a fraction of the scene
+    // size. Pixels that saw nothing start at the cap.
+    void initializeRadii() {
+        if (maxRadius <= 0) {
+            return;
+        }
+        float spread = Constant::initialRadiusPixels * camera->getPixelSpread();
+        for (int i = 0; i < image.Width() * image.Height(); ++i) {
+            Pixel &pixel = *image(i);
+            float radius = spread * (pixel.hitPoint - camera->getCenter()).length();
+            radius = std::isfinite(radius) ? min(radius, maxRadius) : maxRadius;
+            pixel.squaredRadius = radius * radius;
+        }
+    }
     void generateImage(int epoch) {
         for (int x = 0; x < image.Width(); ++x) {
             for (int y = 0; y < image.Height(); ++y) {
                 Pixel &pixel = image(x, y);
-                Vector3f color = (pixel.flux / (M_PI * pixel.squaredRadius * Constant::numPhotons) + pixel.phos) / epoch;
+                if (pixel.samples == 0) {
+                    continue;
+                }
+                // Converged pixels stopped gathering light early, so each
+                // pixel averages over the epochs that sampled it.
+                Vector3f color = (pixel.flux / (M_PI * pixel.squaredRadius * Constant::numPhotons) + pixel.phos) / pixel.samples;
                 pixel.color = Utils::clamp(Utils::gammaCorrect(color));
             }
         }
     }
+    // Epochs that sampled each pixel, as a ramp from blue for none to red
+    // for all of them.
+    void saveSampleMap(const char *filename, int epoch) {
+        Image heat(image.Width(), image.Height());
+        for (int i = 0; i < image.Width() * image.Height(); ++i) {
+            float t = (float)image(i)->samples / epoch;
+            heat(i)->color = Vector3f(t, 1 - fabs(2 * t - 1), 1 - t);
+        }
+        heat.SaveBMP(filename);
+    }
     Ray generateBeam(Vector3f &color) {
-        static int counter = 0;
         // Select an illuminant to generate a beam.
-        counter = (counter + 1) % baseGroup->getIlluminantSize();
-        return baseGroup->generateBeam(color, counter);
+        return baseGroup->generateBeam(color);
+    }
+    // Lists the eye pass tiles in the order threads take them. Consecutive
+    // tiles along a Morton or Hilbert curve are neighbours, so the tiles in
+    // flight at once look at nearby geometry.
+    void orderTiles(Option::TileOrder order) {
+        int size = Option::tileSize;
+        int tilesX = (image.Width() + size - 1) / size, tilesY = (image.Height() + size - 1) / size;
+        uint32_t side = 1;
+        while (side < (uint32_t)max(tilesX, tilesY)) {
+            side <<= 1;
+        }
+        vector<pair<uint32_t, int>> keyed;
+        for (int ty = 0; ty < tilesY; ++ty) {
+            for (int tx = 0; tx < tilesX; ++tx) {
+                uint32_t key = order == Option::hilbertOrder ? Utils::hilbert(side, tx, ty) : order == Option::mortonOrder ? Utils::morton(tx, ty) : ty * tilesX + tx;
+                keyed.push_back(make_pair(key, ty * tilesX + tx));
+            }
+        }
+        sort(keyed.begin(), keyed.end());
+        tiles.clear();
+        for (const auto &tile : keyed) {
+            tiles.push_back(tile.second);
+        }
+    }
+    // Threads take one tile at a time off the shared list and trace it row
+    // by row, so each thread writes a compact block of pixels. Without depth
+    // of field the primary rays of a block of pixels leave from one point,
+    // and are intersected together as a packet.
+    void rayTracingPass(int epoch) {
+        int size = Option::tileSize, tilesX = (image.Width() + size - 1) / size;
+        int packet = camera->hasDepthOfField() ? 1 : Option::packetSize;
+        int blockWidth = packet >= 8 ? 4 : packet == 4 ? 2 : 1, blockHeight = packet / blockWidth;
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int k = 0; k < (int)tiles.size(); ++k) {
+            int left = tiles[k] % tilesX * size, top = tiles[k] / tilesX * size;
+            int right = min(left + size, image.Width()), bottom = min(top + size, image.Height());
+            for (int y = top; y < bottom; y += blockHeight) {
+                for (int x = left; x < right; x += blockWidth) {
+                    traceBlock(epoch, x, y, min(x + blockWidth, right), min(y + blockHeight, bottom));
+                }
+            }
+        }
+    }
+    // Traces the pixels of [left, right) x [top, bottom). Each pixel keeps
+    // its random stream across the packet, so packets change no image.
+    void traceBlock(int epoch, int left, int top, int right, int bottom) {
+        if (right - left == 1 && bottom - top == 1) {
+            Random::rekey((uint64_t)epoch << 32 | (top * image.Width() + left));
+            Pixel &pixel = image(left, top);
+            if (!pixel.converged) {
+                Vector3f phos = pixel.phos;
+                rayTrace(pixel, camera->generateDistributedRay(Vector2f(left, top)));
+                pixel.direct = pixel.phos - phos;
+            }
+            return;
+        }
+        vector<Ray> rays;
+        rays.reserve(RayPacket::maxSize);
+        Pixel *pixels[RayPacket::maxSize];
+        Random streams[RayPacket::maxSize];
+        for (int y = top; y < bottom; ++y) {
+            for (int x = left; x < right; ++x) {
+                Pixel &pixel = image(x, y);
+                if (pixel.converged) {
+                    continue;
+                }
+                Random::rekey((uint64_t)epoch << 32 | (y * image.Width() + x));
+                rays.push_back(camera->generateDistributedRay(Vector2f(x, y)));
+                streams[rays.size() - 1] = Random::local();
+                pixels[rays.size() - 1] = &pixel;
+            }
+        }
+        if (rays.empty()) {
+            return;
+        }
+        RayPacket packet(rays.data(), rays.size());
+        Hit hits[RayPacket::maxSize];
+        Profiler::count(Profiler::rays, packet.size);
+        unsigned hit = baseGroup->intersectPacket(packet, hits, packet.fullMask(), Constant::tmin);
+        for (int i = 0; i < packet.size; ++i) {
+            if (hit >> i & 1) {
+                hits[i].computeSurfaceInteraction(rays[i]);
+            }
+            Random::local() = streams[i];
+            Vector3f phos = pixels[i]->phos;
+            rayTrace(*pixels[i], rays[i], &hits[i]);
+            pixels[i]->direct = pixels[i]->phos - phos;
+        }
+    }
+    void photonTracingPass(int epoch, int threads) {
+        Profiler::count(Profiler::photons, Constant::numPhotons);
+        if (Option::wavefront) {
+            photonWavefrontPass(epoch, threads);
+            return;
+        }
+#pragma omp parallel num_threads(threads)
+        {
+            vector<PhotonDeposit> batch;
+            batch.reserve(Constant::depositBatch);
+#pragma omp for schedule(dynamic, 256)
+            for (int i = 0; i < Constant::numPhotons; ++i) {
+                Random::rekey(photonStream | (uint64_t)epoch << 32 | i);
+                Vector3f color;
+                Ray beam = generateBeam(color);
+                photonTrace(beam, color, batch);
+            }
+            photonMap->update(batch);
+        }
+    }
+    // The photons of an epoch traced breadth first, Constant::wavefrontSize
+    // at a time. Each bounce runs as separate sweeps over the whole queue:
+    // intersect every path, group the paths by the bounce they drew, scatter
+    // each group, then deposit the diffuse hits sorted along a Z-order curve
+    // so consecutive deposits touch the same part of the photon map. Paths
+    // carry their own random streams, so the photons and the image are the
+    // same as in the depth-first pass.
+    void photonWavefrontPass(int epoch, int threads) {
+        struct PhotonPath {
+            Vector3f origin, direction, accumulate;
+            float time;
+            int depth;
+            Bounce bounce;
+            Random stream;
+        };
+        // Hits are written in place and never copied.
+        vector<Hit> hits(Constant::wavefrontSize);
+        vector<PhotonPath> paths, survivors;
+        vector<PhotonDeposit> deposits;
+        vector<int> order;
+        for (int first = 0; first < Constant::numPhotons; first += Constant::wavefrontSize) {
+            paths.resize(min(Constant::wavefrontSize, Constant::numPhotons - first));
+#pragma omp parallel for schedule(static) num_threads(threads)
+            for (int i = 0; i < (int)paths.size(); ++i) {
+                Random::rekey(photonStream | (uint64_t)epoch << 32 | (first + i));
+                PhotonPath &path = paths[i];
+                Ray beam = generateBeam(path.accumulate);
+                path.origin = beam.getOrigin();
+                path.direction = beam.getDirection();
+                path.time = beam.getTime();
+                path.depth = 0;
+                path.stream = Random::local();
+            }
+            while (!paths.empty()) {
+                int size = paths.size();
+#pragma omp parallel for schedule(dynamic, 256) num_threads(threads)
+                for (int i = 0; i < size; ++i) {
+                    PhotonPath &path = paths[i];
+                    Random::local() = path.stream;
+                    path.bounce = absorbedBounce;
+                    if (path.depth > Constant::russianRoulette) {
+                        float maxAccumulate = Utils::max(path.accumulate);
+                        if (Utils::randomEngine() < maxAccumulate) {
+                            path.accumulate *= (1 / maxAccumulate);
+                        } else {
+                            path.stream = Random::local();
+                            continue;
+                        }
+                    }
+                    hits[i] = Hit();
+                    if (intersect(Ray(path.origin, path.direction, path.time), hits[i])) {
+                        path.accumulate *= hits[i].getColor();
+                        path.bounce = chooseBounce(hits[i]);
+                    }
+                    path.stream = Random::local();
+                }
+                // Counting sort by bounce, diffuse paths first.
+                int start[absorbedBounce + 2] = {0};
+                for (int i = 0; i < size; ++i) {
+                    ++start[paths[i].bounce + 1];
+                }
+                for (int k = 0; k <= absorbedBounce; ++k) {
+                    start[k + 1] += start[k];
+                }
+                int diffuse = start[diffuseBounce + 1], alive = start[absorbedBounce];
+                order.resize(size);
+                for (int i = 0; i < size; ++i) {
+                    order[start[paths[i].bounce]++] = i;
+                }
+                deposits.resize(diffuse);
+#pragma omp parallel for schedule(dynamic, 256) num_threads(threads)
+                for (int k = 0; k < alive; ++k) {
+                    PhotonPath &path = paths[order[k]];
+                    const Hit &hit = hits[order[k]];
+                    Random::local() = path.stream;
+                    Ray beam(path.origin, path.direction, path.time);
+                    if (k < diffuse) {
+                        deposits[k] = makeDeposit(beam.pointAtParameter(hit.getT()), path.accumulate);
+                    }
+                    scatter(beam, hit, path.bounce);
+                    path.origin = beam.getOrigin();
+                    path.direction = beam.getDirection();
+                    ++path.depth;
+                    path.stream = Random::local();
+                }
+                PhotonMap::sortByKey(deposits);
+#pragma omp parallel for schedule(static) num_threads(threads)
+                for (int k = 0; k < diffuse; ++k) {
+                    photonMap->update(deposits[k].position, deposits[k].accumulate);
+                }
+                // The next queue keeps the paths of a bounce kind together.
+                survivors.clear();
+                for (int k = 0; k < alive; ++k) {
+                    if (paths[order[k]].depth < Constant::traceThreshold) {
+                        survivors.push_back(paths[order[k]]);
+                    }
+                }
+                paths.swap(survivors);
+            }
+        }
     }
     void render(int epochs, int checkpoint, bool savePixels = true, int lastEpoch = 0) {
-        clock_t apocalypse = clock();
+        double apocalypse = omp_get_wtime();
         if (lastEpoch > 0) {
             char filename[100];
             sprintf(filename, "checkpoints/checkpoint-%d.pxl", lastEpoch);
-            image.readPixels(filename);
+            int epoch = lastEpoch;
+            // Continue the random streams of the interrupted run.
+            if (image.readPixels(filename, epoch, Random::seed()) && epoch != lastEpoch) {
+                fprintf(stderr, "Checkpoint %s was saved at epoch %d\n", filename, epoch);
+                exit(1);
+            }
+            fprintf(stderr, "Resumed from epoch %d, seed %llu\n", lastEpoch, (unsigned long long)Random::seed());
         }
         for (int epoch = lastEpoch + 1; epoch <= epochs; ++epoch) {
             fprintf(stderr, "Round %d/%d\n", epoch, epochs);
             // Ray tracing pass
             fprintf(stderr, "\rRay tracing pass begin");
-#pragma omp parallel for schedule(dynamic, 1)
-            for (int x = 0; x < image.Width(); ++x) {
-                for (int y = 0; y < image.Height(); ++y) {
-                    Pixel &pixel = image(x, y);
-                    Ray ray = camera->generateDistributedRay(Vector2f(x, y));
-                    rayTrace(pixel, ray);
+            {
+                Profiler::Scope scope(Profiler::eyePass);
+                rayTracingPass(epoch);
+                if (epoch == 1) {
+                    initializeRadii();
                 }
             }
             fprintf(stderr, "\rRay tracing pass finish\n");
             // Photon tracing pass
             fprintf(stderr, "\rPhoton tracing pass begin");
-            kdtree.construct();
-#pragma omp parallel for schedule(dynamic, 1)
-            for (int i = 0; i < Constant::numPhotons; ++i) {
-                Vector3f color;
-                Ray beam = generateBeam(color);
-                photonTrace(beam, color);
+            {
+                Profiler::Scope scope(Profiler::mapBuild);
+                photonMap->construct();
+            }
+            {
+                Profiler::Scope scope(Profiler::photonPass);
+                photonTracingPass(epoch, omp_get_max_threads());
+            }
+            {
+                Profiler::Scope scope(Profiler::merge);
+                photonMap->merge(Option::adaptive);
             }
-            kdtree.destroy();
             fprintf(stderr, "\rPhoton tracing pass finish\n");
-            // Save checkpoint
-            if (epoch % checkpoint == 0) {
-                generateImage(epoch);
+            fprintf(stderr, "Photons per pixel: %.2f, starved pixels: %.1f%%\n", photonMap->getGatheredPerPixel(), 100 * photonMap->getStarvedShare());
+            if (Option::adaptive > 0) {
+                fprintf(stderr, "Converged pixels: %.1f%%\n", 100 * photonMap->getConvergedShare());
+            }
+            // Save checkpoint; a period of 0 or less never does.
+            if (checkpoint > 0 && epoch % checkpoint == 0) {
                 char filename[100];
-                sprintf(filename, "checkpoints/checkpoint-%d.bmp", epoch);
-                image.SaveBMP(filename);
+                {
+                    Profiler::Scope scope(Profiler::imageOutput);
+                    generateImage(epoch);
+                    sprintf(filename, "checkpoints/checkpoint-%d.bmp", epoch);
+                    image.SaveBMP(filename);
+                    if (Option::adaptive > 0) {
+                        sprintf(filename, "checkpoints/samples-%d.bmp", epoch);
+                        saveSampleMap(filename, epoch);
+                    }
+                }
                 if (savePixels) {
+                    Profiler::Scope scope(Profiler::checkpointOutput);
                     sprintf(filename, "checkpoints/checkpoint-%d.pxl", epoch);
-                    image.SavePixels(filename);
+                    image.SavePixels(filename, epoch, Random::seed());
                 }
-                fprintf(stderr, "Total time: %.3fs\n", float(clock() - apocalypse) / CLOCKS_PER_SEC);
+                fprintf(stderr, "Total time: %.3fs\n", omp_get_wtime() - apocalypse);
+                fprintf(stderr, "Photon map builds: %d in %d epochs\n", photonMap->getBuilds(), epoch - lastEpoch);
             }
+            Profiler::endEpoch(epoch);
         }
         generateImage(epochs);
     }
+    void benchmark(int rounds = 3) {
+        // Closest-hit queries per second for the primary rays, on one thread,
+        // repeated for at least a second.
+        double start = omp_get_wtime();
+        int hits = 0, round = 0;
+        for (; round < rounds || omp_get_wtime() - start < 1; ++round) {
+            for (int y = 0; y < image.Height(); ++y) {
+                for (int x = 0; x < image.Width(); ++x) {
+                    Random::rekey(y * image.Width() + x);
+                    Hit hit;
+                    hits += intersect(camera->generateDistributedRay(Vector2f(x, y)), hit);
+                }
+            }
+        }
+        double rays = (double)round * image.Width() * image.Height();
+        fprintf(stderr, "primary rays/s\t%.0f\t(%.1f%% hit)\n", rays / (omp_get_wtime() - start), 100 * hits / rays);
+        // The same queries as packets over blocks of pixels.
+        fprintf(stderr, "packet\tprimary rays/s\n");
+        for (int packetSize = 4; packetSize <= RayPacket::maxSize; packetSize *= 2) {
+            int blockWidth = packetSize >= 8 ? 4 : 2, blockHeight = packetSize / blockWidth;
+            start = omp_get_wtime();
+            for (round = 0; round < rounds || omp_get_wtime() - start < 1; ++round) {
+                for (int top = 0; top < image.Height(); top += blockHeight) {
+                    for (int left = 0; left < image.Width(); left += blockWidth) {
+                        vector<Ray> block;
+                        for (int y = top; y < min(top + blockHeight, image.Height()); ++y) {
+                            for (int x = left; x < min(left + blockWidth, image.Width()); ++x) {
+                                Random::rekey(y * image.Width() + x);
+                                block.push_back(camera->generateDistributedRay(Vector2f(x, y)));
+                            }
+                        }
+                        RayPacket packet(block.data(), block.size());
+                        Hit blockHits[RayPacket::maxSize];
+                        Profiler::count(Profiler::rays, packet.size);
+                        unsigned hit = baseGroup->intersectPacket(packet, blockHits, packet.fullMask(), Constant::tmin);
+                        for (int i = 0; i < packet.size; ++i) {
+                            if (hit >> i & 1) {
+                                blockHits[i].computeSurfaceInteraction(block[i]);
+                            }
+                        }
+                    }
+                }
+            }
+            rays = (double)round * image.Width() * image.Height();
+            fprintf(stderr, "%d\t%.0f\n", packetSize, rays / (omp_get_wtime() - start));
+        }
+        // Whole eye passes on all threads, for each tile order.
+        Option::TileOrder orders[] = {Option::rowOrder, Option::mortonOrder, Option::hilbertOrder};
+        const char *orderNames[] = {"row", "morton", "hilbert"};
+        fprintf(stderr, "tile order\teye pass ms\n");
+        for (int k = 0; k < 3; ++k) {
+            orderTiles(orders[k]);
+            start = omp_get_wtime();
+            for (round = 0; round < rounds; ++round) {
+                rayTracingPass(round + 1);
+            }
+            fprintf(stderr, "%s\t%.2f\n", orderNames[k], (omp_get_wtime() - start) * 1000 / rounds);
+        }
+        orderTiles(Option::tileOrder);
+        // Photon pass throughput against thread count, over the visible points of one eye pass.
+        rayTracingPass(1);
+        initializeRadii();
+        photonMap->construct();
+        int maxThreads = omp_get_max_threads();
+        double base = 0;
+        fprintf(stderr, "threads\tphotons/s\tspeedup\n");
+        for (int threads = 1; ; threads = threads * 2 < maxThreads ? threads * 2 : maxThreads) {
+            start = omp_get_wtime();
+            for (round = 0; round < rounds; ++round) {
+                photonTracingPass(round + 1, threads);
+            }
+            double throughput = rounds * Constant::numPhotons / (omp_get_wtime() - start);
+            base = threads == 1 ? throughput : base;
+            fprintf(stderr, "%d\t%.0f\t%.2f\n", threads, throughput, throughput / base);
+            if (threads == maxThreads) {
+                break;
+            }
+        }
+        photonMap->merge();
+        // Both photon maps over the same visible points, on all threads.
+        PhotonMap *selected = photonMap;
+        PhotonMap *maps[] = {new KDTree(image), new HashGrid(image)};
+        const char *names[] = {"kdtree", "grid"};
+        fprintf(stderr, "photon map\tbuild ms\tphotons/s\n");
+        for (int k = 0; k < 2; ++k) {
+            photonMap = maps[k];
+            start = omp_get_wtime();
+            photonMap->construct();
+            double build = omp_get_wtime() - start;
+            start = omp_get_wtime();
+            for (round = 0; round < rounds; ++round) {
+                photonTracingPass(round + 1, maxThreads);
+            }
+            double throughput = rounds * Constant::numPhotons / (omp_get_wtime() - start);
+            fprintf(stderr, "%s\t%.2f\t%.0f\n", names[k], build * 1000, throughput);
+            delete photonMap;
+        }
+        photonMap = selected;
+        // Depth-first against breadth-first photon tracing, on all threads.
+        bool wavefront = Option::wavefront;
+        fprintf(stderr, "photon engine\tphotons/s\n");
+        for (int k = 0; k < 2; ++k) {
+            Option::wavefront = k == 1;
+            start = omp_get_wtime();
+            for (round = 0; round < rounds; ++round) {
+                photonTracingPass(round + 1, maxThreads);
+            }
+            fprintf(stderr, "%s\t%.0f\n", k ? "wavefront" : "depth-first", rounds * Constant::numPhotons / (omp_get_wtime() - start));
+        }
+        Option::wavefront = wavefront;
+    }
     Image* getImage() {
         return &image;
     }
     ~Chroma() {
+        delete photonMap;
         camera = nullptr;
         baseGroup = nullptr;
     }
 protected:
-    KDTree kdtree;
+    // Keeps photon streams apart from the per-pixel streams of the eye pass.
+    static const uint64_t photonStream = 1ULL << 62;
+    PhotonMap *photonMap;
+    // Eye pass tiles, numbered row by row, in scheduling order.
+    vector<int> tiles;
+    // Scales scene coordinates to the lattice deposits are keyed by.
+    Vector3f depositScale;
+    float maxRadius;
     Camera *camera;
     Vector3f backgroundColor;
     Group *baseGroup;
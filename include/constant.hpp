@@ -8,10 +8,21 @@ public:
     static const int russianRoulette;
     static const float tmin;
     static const int bvhmax;
+    static const int bvhLeafMax;
+    static const float bvhTraversalCost;
     static const int kdmax;
+    static const float kdRefitTolerance;
     static const float strongPhos;
     static const float squaredRadius;
+    static const float initialRadiusPixels;
+    static const float maxRadiusFraction;
+    static const float starvedGrowth;
+    static const float targetPhotons;
     static const int numPhotons;
+    static const int wavefrontSize;
+    static const int depositBatch;
+    static const int minSamples;
+    static const float adaptiveFloor;
     static const float tangentScale;
 };
 
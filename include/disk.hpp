@@ -39,6 +39,9 @@ public:
             time
         );
     }
+    float getArea() const override {
+        return M_PI * radius * radius;
+    }
 protected:
     Vector3f center;
     Vector3f normal;
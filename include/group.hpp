@@ -1,6 +1,7 @@
 #ifndef GROUP_H
 #define GROUP_H
 
+#include "alias.hpp"
 #include "bvh.hpp"
 #include "object3d.hpp"
 #include "ray.hpp"
@@ -22,7 +23,9 @@ public:
     ~Group() override {}
 
     bool intersect(const Ray &r, Hit &h, float tmin) override {
-        bool groupIntersect = tree.intersect(r, h, tmin);
+        bool groupIntersect = tree.intersect(r, h.getT(), [&](int i) {
+            return objects[i]->intersect(r, h, tmin);
+        });
         // bool groupIntersect = false;
         // for (Object3D* obj : objects) {
         //     groupIntersect = obj->intersect(r, h, tmin) || groupIntersect;
@@ -33,6 +36,16 @@ public:
         return groupIntersect;
     }
 
+    unsigned intersectPacket(RayPacket &packet, Hit *hits, unsigned mask, float tmin) override {
+        unsigned hit = tree.intersectPacket(packet, mask, [&](int i, unsigned rays) {
+            return objects[i]->intersectPacket(packet, hits, rays, tmin);
+        });
+        for (Object3D* obj : uncensored) {
+            hit |= obj->intersectPacket(packet, hits, mask, tmin);
+        }
+        return hit;
+    }
+
     void addObject(int index, Object3D *obj) {
         if (obj->getMaterial() && obj->getMaterial()->getPhos() != Vector3f::ZERO) {
             illuminants.push_back(obj);
@@ -46,11 +59,35 @@ public:
 
     void activate() {
         tree.construct(objects);
+        if (!objects.empty()) {
+            konta = tree.getKonta();
+            makria = tree.getMakria();
+        }
+        // Lights are picked in proportion to the power they emit, their
+        // brightness times their area. A photon carries its light's power
+        // over the pick probability, scaled so that Constant::strongPhos
+        // stays the power of a light of the mean area.
+        int size = illuminants.size();
+        std::vector<float> areas(size), powers(size);
+        float totalArea = 0;
+        for (int k = 0; k < size; ++k) {
+            areas[k] = illuminants[k]->getArea();
+            powers[k] = Utils::luminance(illuminants[k]->getMaterial()->getPhos()) * areas[k];
+            totalArea += areas[k];
+        }
+        lights.build(powers);
+        lightScales.resize(size);
+        for (int k = 0; k < size; ++k) {
+            float pdf = lights.getPdf(k);
+            // Without areas every light is equally likely and equally strong.
+            lightScales[k] = totalArea > 0 ? (pdf > 0 ? areas[k] / (totalArea * pdf) : 0) : 1;
+        }
     }
 
-    Ray generateBeam(Vector3f &color, int idx) {
-        Object3D *illuminant = illuminants[idx];
-        color = illuminant->getMaterial()->getPhos() * Constant::strongPhos;
+    Ray generateBeam(Vector3f &color) {
+        int k = lights.sample(Utils::randomEngine());
+        Object3D *illuminant = illuminants[k];
+        color = illuminant->getMaterial()->getPhos() * (Constant::strongPhos * lightScales[k]);
         return illuminant->generateBeam(Utils::randomEngine(tStart, tEnd));
     }
 
@@ -65,6 +102,8 @@ public:
 private:
     std::vector<Object3D*> objects, illuminants, uncensored;
     BVH tree;
+    AliasTable lights;
+    std::vector<float> lightScales;
     float tStart, tEnd;
 };
 
@@ -0,0 +1,129 @@
+#ifndef HASH_GRID_H
+#define HASH_GRID_H
+
+#include "photon_map.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// Uniform grid hashed into a table, rebuilt every epoch. Cells are as wide
+// as the largest search diameter, and every visible point is stored in each
+// cell its radius reaches, so a photon only reads the bucket of its own cell.
+// Buckets are packed back to back (CSR): bucket k holds
+// entries[start[k]..start[k + 1]).
+class HashGrid : public PhotonMap {
+public:
+    HashGrid(Image &image): PhotonMap(image), inverseCellSize(1) {
+        int buckets = 1;
+        while (buckets < size) {
+            buckets <<= 1;
+        }
+        start.resize(buckets + 1);
+        mask = buckets - 1;
+    }
+    void construct() {
+        select();
+        gather();
+        // Points that escaped the scene are never reached by a photon.
+        float maxSquaredRadius = 0;
+        konta = Vector3f(1e30);
+        for (int i = 0; i < active; ++i) {
+            Vector3f point(hitX[i], hitY[i], hitZ[i]);
+            if (!finite(point)) {
+                continue;
+            }
+            konta = Utils::min(konta, point);
+            maxSquaredRadius = max(maxSquaredRadius, squaredRadius[i]);
+        }
+        float radius = sqrt(maxSquaredRadius);
+        konta = konta - radius;
+        inverseCellSize = 1 / max(2 * radius, 1e-6f);
+        fill(start.begin(), start.end(), 0);
+        // Count the entries of every bucket, then place them.
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < active; ++i) {
+            int buckets[8];
+            int count = reach(i, buckets);
+            for (int k = 0; k < count; ++k) {
+#pragma omp atomic
+                ++start[buckets[k] + 1];
+            }
+        }
+        for (size_t k = 1; k < start.size(); ++k) {
+            start[k] += start[k - 1];
+        }
+        entries.resize(start.back());
+        vector<int> cursor(start.begin(), start.end() - 1);
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < active; ++i) {
+            int buckets[8];
+            int count = reach(i, buckets);
+            for (int k = 0; k < count; ++k) {
+                int slot;
+#pragma omp atomic capture
+                slot = cursor[buckets[k]]++;
+                entries[slot] = i;
+            }
+        }
+        ++builds;
+    }
+    void update(const Vector3f &position, const Vector3f &accumulate) {
+        int cell[3];
+        for (int k = 0; k < 3; ++k) {
+            float offset = (position[k] - konta[k]) * inverseCellSize;
+            if (!(offset >= 0 && offset < 1e9f)) {
+                return;
+            }
+            cell[k] = (int)offset;
+        }
+        int bucket = hash(cell[0], cell[1], cell[2]);
+        for (int j = start[bucket]; j < start[bucket + 1]; ++j) {
+            deposit(entries[j], position, accumulate);
+        }
+    }
+protected:
+    static bool finite(const Vector3f &v) {
+        return std::isfinite(v.x()) && std::isfinite(v.y()) && std::isfinite(v.z());
+    }
+    int hash(int x, int y, int z) const {
+        return (int)(((unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)z * 83492791u) & mask);
+    }
+    // Distinct buckets of the cells the radius of visible point i reaches.
+    // With cells a diameter wide that is at most 2x2x2 cells; rounding can
+    // push hi one cell further, so it is clamped to keep within buckets[8].
+    int reach(int i, int *buckets) const {
+        Vector3f point(hitX[i], hitY[i], hitZ[i]);
+        if (!finite(point)) {
+            return 0;
+        }
+        float radius = sqrt(squaredRadius[i]);
+        int lo[3], hi[3];
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = (int)((point[k] - radius - konta[k]) * inverseCellSize);
+            hi[k] = min((int)((point[k] + radius - konta[k]) * inverseCellSize), lo[k] + 1);
+        }
+        int count = 0;
+        for (int x = lo[0]; x <= hi[0]; ++x) {
+            for (int y = lo[1]; y <= hi[1]; ++y) {
+                for (int z = lo[2]; z <= hi[2]; ++z) {
+                    int bucket = hash(x, y, z);
+                    // Two cells may share a bucket; store the point once.
+                    if (find(buckets, buckets + count, bucket) == buckets + count) {
+                        buckets[count++] = bucket;
+                    }
+                }
+            }
+        }
+        return count;
+    }
+    Vector3f konta;
+    float inverseCellSize;
+    unsigned mask;
+    vector<int> start;
+    vector<int> entries;
+};
+
+#endif
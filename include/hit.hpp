@@ -5,32 +5,25 @@
 #include "ray.hpp"
 
 class Material;
+class Object3D;
 
+// Intersection is two-staged. While the closest hit is searched for, objects
+// only record where it is: t, the object and primitive, and the surface
+// coordinates there (barycentric or uv). Material, normal and color are
+// worked out once, by computeSurfaceInteraction on the hit that was kept.
+// Objects whose shading costs nothing set them straight away instead.
 class Hit {
 public:
 
     // constructors
-    Hit() {
-        material = nullptr;
-        t = 1e38;
-    }
+    Hit(): t(1e38), u(0), v(0), primitive(0), object(nullptr), instance(nullptr), material(nullptr) {}
 
-    Hit(float _t, Material *m, const Vector3f &n) {
-        t = _t;
-        material = m;
-        normal = n;
-    }
-
-    Hit(const Hit &h) {
-        t = h.t;
-        material = h.material;
-        normal = h.normal;
-    }
+    Hit(float _t, Material *m, const Vector3f &n): t(_t), u(0), v(0), primitive(0), object(nullptr), instance(nullptr), material(m), normal(n) {}
 
     // destructor
     ~Hit() = default;
 
-    float getT() const {
+    const float &getT() const {
         return t;
     }
 
@@ -46,15 +39,64 @@ public:
         return color;
     }
 
+    float getU() const {
+        return u;
+    }
+
+    float getV() const {
+        return v;
+    }
+
+    int getPrimitive() const {
+        return primitive;
+    }
+
+    // The object left to shade the hit, null once it is shaded.
+    Object3D *getObject() const {
+        return object;
+    }
+
+    // The transform the hit was found through, if shading waits on one.
+    Object3D *getInstance() const {
+        return instance;
+    }
+
+    void setInstance(Object3D *transform) {
+        instance = transform;
+    }
+
+    void setNormal(const Vector3f &n) {
+        normal = n;
+    }
+
+    void record(float _t, Object3D *o, int p = 0, float _u = 0, float _v = 0) {
+        t = _t;
+        u = _u;
+        v = _v;
+        primitive = p;
+        object = o;
+        instance = nullptr;
+    }
+
     void set(float _t, Material *m, const Vector3f &n, const Vector3f &c) {
         t = _t;
+        object = nullptr;
+        instance = nullptr;
         material = m;
         normal = n;
         color = c;
     }
 
+    // Shades a recorded hit of the ray it was found for. Defined with
+    // Object3D.
+    void computeSurfaceInteraction(const Ray &r);
+
 private:
     float t;
+    float u, v;
+    int primitive;
+    Object3D *object;
+    Object3D *instance;
     Material *material;
     Vector3f normal;
     Vector3f color;
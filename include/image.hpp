@@ -1,9 +1,12 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <vecmath.h>
 #include "constant.hpp"
+#include <cstdint>
 #include <fstream>
 
 class Pixel {
@@ -14,14 +17,48 @@ public:
     Vector3f flux;
     Vector3f phos;
     Vector3f normal;
+    // Light the eye pass of the current epoch added to phos.
+    Vector3f direct;
     int numPhotons;
     int incPhotons;
     float squaredRadius;
+    // Epochs that sampled the pixel, and the running mean and squared
+    // deviations (Welford) of their radiance estimates.
+    int samples;
+    float mean;
+    float m2;
+    bool converged;
+
+    Pixel(): color(0), hitPoint(0), accumulate(0), flux(0), phos(0), normal(0), direct(0), numPhotons(0), incPhotons(0), squaredRadius(Constant::squaredRadius), samples(0), mean(0), m2(0), converged(false) {}
+
+    void record(float sample) {
+        ++samples;
+        float delta = sample - mean;
+        mean += delta / samples;
+        m2 += delta * (sample - mean);
+    }
 
-    Pixel(): color(0), hitPoint(0), accumulate(0), flux(0), phos(0), normal(0), numPhotons(0), incPhotons(0), squaredRadius(Constant::squaredRadius) {}
+    // Standard error of the mean estimate, relative to the mean. Means
+    // below Constant::adaptiveFloor count as the floor, so black pixels
+    // converge too.
+    float relativeError() const {
+        if (samples < 2) {
+            return 1e30;
+        }
+        return std::sqrt(m2 / (samples - 1) / samples) / std::max(mean, Constant::adaptiveFloor);
+    }
 
     void update() {
-        float updPhotons = numPhotons + Constant::sppmAlpha * incPhotons;
+        if (numPhotons == 0 && incPhotons == 0) {
+            // Nothing gathered yet, so no flux depends on the radius: widen
+            // it until photons arrive.
+            squaredRadius = std::min(squaredRadius * Constant::starvedGrowth, maxSquaredRadius);
+            return;
+        }
+        // Pixels gathering only a photon or two keep more of them, and
+        // shrink their radius more slowly than well-lit ones.
+        float alpha = Constant::sppmAlpha + (1 - Constant::sppmAlpha) * exp(-incPhotons / Constant::targetPhotons);
+        float updPhotons = numPhotons + alpha * incPhotons;
         int totPhotons = numPhotons + incPhotons;
         float rate = totPhotons > 0 ? updPhotons / totPhotons : 1;
         numPhotons = (int)(updPhotons + 0.5);
@@ -29,6 +66,33 @@ public:
         flux *= rate;
         squaredRadius *= rate;
     }
+
+    // Upper bound for widening radii, set from the scene size.
+    static float maxSquaredRadius;
+};
+
+// Binary checkpoint (.pxl): a PixelHeader followed by width * height
+// PixelRecords in row-major order.
+struct PixelHeader {
+    char magic[4];
+    int32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t epoch;
+    int32_t reserved;
+    uint64_t seed;
+};
+
+// Version 1 records end at squaredRadius.
+struct PixelRecord {
+    float flux[3];
+    float phos[3];
+    int32_t numPhotons;
+    float squaredRadius;
+    int32_t samples;
+    int32_t converged;
+    float mean;
+    float m2;
 };
 
 // Simple image class
@@ -90,12 +154,19 @@ public:
 
     void SaveImage(const char *filename);
 
-    void readPixels(const char *filename);
+    // Loads a checkpoint, binary or legacy text. Only a binary checkpoint
+    // carries the epoch and seed; returns whether they were filled in.
+    // Checkpoints without sample counts count epoch samples per pixel.
+    bool readPixels(const char *filename, int &epoch, uint64_t &seed);
+
+    void SavePixels(const char *filename, int epoch, uint64_t seed);
 
-    void SavePixels(const char *filename);
+    static const int pixelVersion = 2;
 
 private:
 
+    void readTextPixels(const char *filename, int epoch);
+
     int width;
     int height;
     Pixel *data;
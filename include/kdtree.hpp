@@ -1,135 +1,211 @@
 #ifndef KDTREE_H
 #define KDTREE_H
 
-#include "image.hpp"
+#include "photon_map.hpp"
 #include "utils.hpp"
 #include "constant.hpp"
 #include <algorithm>
+#include <vector>
 #include <iostream>
-#include <mutex>
 
 using namespace std;
 
 class KDTreeNode {
 public:
     Vector3f konta, makria;
-    KDTreeNode *lc, *rc;
+    int lc, rc;
     int lo, hi;
+    int axis;
+    Vector3f split;
     float maxSquaredRadius;
-    KDTreeNode(): konta(1e100), makria(-1e100), lc(nullptr), rc(nullptr), lo(-1), hi(-1), maxSquaredRadius(0) {}
+    KDTreeNode(): konta(1e100), makria(-1e100), lc(-1), rc(-1), lo(-1), hi(-1), axis(0), split(0), maxSquaredRadius(0) {}
 };
 
-class KDTree {
+class KDTree : public PhotonMap {
 public:
-    KDTree(Image &image): size(image.Width() * image.Height()) {
-        pixels = new Pixel*[size];
-        for (int i = 0; i < size; ++i) {
-            pixels[i] = image(i);
-        }
+    KDTree(Image &image): PhotonMap(image), builtCost(0), builtActive(0) {
+        scratch = new Pixel*[size];
+        leafOf = new int[size];
     }
+    // Visible points move little between epochs, so the split planes and the
+    // node arena are kept: the points are routed through the old planes into
+    // the leaves, and bounds and radii are refitted bottom-up. The tree is
+    // only rebuilt when its cost grows past Constant::kdRefitTolerance times
+    // the cost right after the last build, or when converged pixels took
+    // half of the points out of it.
     void construct() {
-        root = construct(0, size);
-    }
-    void destroy() {
-        for (int i = 0; i < size; ++i) {
-            pixels[i]->update();
+        select();
+        if (nodes.empty() || active * 2 < builtActive) {
+            rebuild();
+            return;
+        }
+        redistribute();
+        gather();
+        refit();
+        if (cost() > builtCost * Constant::kdRefitTolerance) {
+            rebuild();
         }
-        destroy(root);
-        root = nullptr;
     }
     void update(const Vector3f &position, const Vector3f &accumulate) {
-        update(root, position, accumulate);
+        update(0, position, accumulate);
     }
     ~KDTree() {
-        if (root) {
-            destroy(root);
-        }
-        if (pixels) {
-            for (int i = 0; i < size; ++i) {
-                pixels[i] = nullptr;
-            }
-            delete[] pixels;
-        }
+        delete[] scratch;
+        delete[] leafOf;
     }
 protected:
-    KDTreeNode* construct(int lo, int hi) {
-        KDTreeNode *node = new KDTreeNode;
+    void rebuild() {
+        nodes.clear();
+        leaves.clear();
+        construct(0, active);
+        gather();
+        builtCost = cost();
+        builtActive = active;
+        ++builds;
+    }
+    // Nodes are laid out in preorder: a left child follows its parent, and
+    // the leaves are met left to right.
+    int construct(int lo, int hi) {
+        int index = nodes.size();
+        nodes.push_back(KDTreeNode());
+        KDTreeNode node;
         for (int i = lo; i < hi; ++i) {
-            node->konta = Utils::min(node->konta, pixels[i]->hitPoint);
-            node->makria = Utils::max(node->makria, pixels[i]->hitPoint);
-            node->maxSquaredRadius = node->maxSquaredRadius < pixels[i]->squaredRadius ? pixels[i]->squaredRadius : node->maxSquaredRadius;
+            node.konta = Utils::min(node.konta, pixels[i]->hitPoint);
+            node.makria = Utils::max(node.makria, pixels[i]->hitPoint);
+            node.maxSquaredRadius = node.maxSquaredRadius < pixels[i]->squaredRadius ? pixels[i]->squaredRadius : node.maxSquaredRadius;
         }
         if (hi - lo <= Constant::kdmax) {
-            node->lo = lo;
-            node->hi = hi;
-            return node;
+            node.lo = lo;
+            node.hi = hi;
+            nodes[index] = node;
+            leaves.push_back(index);
+            return index;
         }
         int mi = lo + hi >> 1;
-        Vector3f scale = node->makria - node->konta;
+        Vector3f scale = node.makria - node.konta;
         if (scale.x() > scale.y() && scale.x() > scale.z()) {
-            nth_element(pixels + lo, pixels + mi, pixels + hi, [](Pixel *a, Pixel *b) {
-                return a->hitPoint.x() < b->hitPoint.x();
-            });
+            node.axis = 0;
         } else if (scale.y() > scale.z()) {
-            nth_element(pixels + lo, pixels + mi, pixels + hi, [](Pixel *a, Pixel *b) {
-                return a->hitPoint.y() < b->hitPoint.y();
-            });
+            node.axis = 1;
         } else {
-            nth_element(pixels + lo, pixels + mi, pixels + hi, [](Pixel *a, Pixel *b) {
-                return a->hitPoint.z() < b->hitPoint.z();
-            });
+            node.axis = 2;
+        }
+        int axis = node.axis;
+        nth_element(pixels + lo, pixels + mi, pixels + hi, [axis](Pixel *a, Pixel *b) {
+            return before(a->hitPoint, b->hitPoint, axis);
+        });
+        node.split = pixels[mi]->hitPoint;
+        node.lc = construct(lo, mi);
+        node.rc = construct(mi, hi);
+        nodes[index] = node;
+        return index;
+    }
+    // Orders points along an axis, breaking ties on the other two axes, so
+    // points on an axis-aligned wall are split the same way when they are
+    // routed again as when the tree was built.
+    static bool before(const Vector3f &a, const Vector3f &b, int axis) {
+        for (int k = 0; k < 3; ++k, axis = axis == 2 ? 0 : axis + 1) {
+            if (a[axis] != b[axis]) {
+                return a[axis] < b[axis];
+            }
+        }
+        return false;
+    }
+    // Routes every visible point through the split planes and regroups the
+    // pixels leaf by leaf, keeping their relative order.
+    void redistribute() {
+        int leafCount = leaves.size();
+        vector<int> position(leafCount + 1, 0);
+        // Leaves park their leaf number in lc while the points are routed.
+        for (int k = 0; k < leafCount; ++k) {
+            nodes[leaves[k]].lc = k;
+        }
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < active; ++i) {
+            const Vector3f &point = pixels[i]->hitPoint;
+            int index = 0;
+            while (nodes[index].hi < 0) {
+                index = before(point, nodes[index].split, nodes[index].axis) ? nodes[index].lc : nodes[index].rc;
+            }
+            leafOf[i] = nodes[index].lc;
+        }
+        for (int i = 0; i < active; ++i) {
+            ++position[leafOf[i] + 1];
+        }
+        for (int k = 0; k < leafCount; ++k) {
+            position[k + 1] += position[k];
+            nodes[leaves[k]].lo = position[k];
+            nodes[leaves[k]].hi = position[k + 1];
+            nodes[leaves[k]].lc = -1;
+        }
+        for (int i = 0; i < active; ++i) {
+            scratch[position[leafOf[i]]++] = pixels[i];
+        }
+        copy(pixels + active, pixels + size, scratch + active);
+        swap(pixels, scratch);
+    }
+    // Recomputes bounds and radii bottom-up over the existing topology.
+    void refit() {
+        int leafCount = leaves.size();
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < leafCount; ++k) {
+            KDTreeNode &node = nodes[leaves[k]];
+            node.konta = Vector3f(1e100);
+            node.makria = Vector3f(-1e100);
+            node.maxSquaredRadius = 0;
+            for (int i = node.lo; i < node.hi; ++i) {
+                Vector3f point(hitX[i], hitY[i], hitZ[i]);
+                node.konta = Utils::min(node.konta, point);
+                node.makria = Utils::max(node.makria, point);
+                node.maxSquaredRadius = max(node.maxSquaredRadius, squaredRadius[i]);
+            }
+        }
+        // Children come after their parent, so a reverse sweep sees them first.
+        for (int index = nodes.size() - 1; index >= 0; --index) {
+            KDTreeNode &node = nodes[index];
+            if (node.hi >= 0) {
+                continue;
+            }
+            const KDTreeNode &left = nodes[node.lc], &right = nodes[node.rc];
+            node.konta = Utils::min(left.konta, right.konta);
+            node.makria = Utils::max(left.makria, right.makria);
+            node.maxSquaredRadius = max(left.maxSquaredRadius, right.maxSquaredRadius);
         }
-        node->lc = construct(lo, mi);
-        node->rc = construct(mi, hi);
-        return node;
     }
-    void destroy(KDTreeNode *node) {
-        if (node->hi < 0) {
-            destroy(node->lc);
-            destroy(node->rc);
+    // Points a deposit scans on average, per visible point: the sum of the
+    // squared leaf sizes over the number of points. Points bunching up in a
+    // few cells is what makes a stale tree slow.
+    double cost() const {
+        double sum = 0;
+        for (int index : leaves) {
+            double count = nodes[index].hi - nodes[index].lo;
+            sum += count * count;
         }
-        delete node;
+        return active ? sum / active : 0;
     }
-    void update(KDTreeNode *node, const Vector3f &position, const Vector3f &accumulate) {
-        Vector3f apoKonta(node->konta - position);
-        Vector3f apoMakria(position - node->makria);
-        // cerr << apoKonta.x() << "\t" << apoMakria.x() << endl;
+    void update(int index, const Vector3f &position, const Vector3f &accumulate) {
+        const KDTreeNode &node = nodes[index];
+        Vector3f apoKonta(node.konta - position);
+        Vector3f apoMakria(position - node.makria);
         float squaredDistance = Utils::relu(apoKonta).squaredLength() + Utils::relu(apoMakria).squaredLength();
-        // cerr << squaredDistance << endl;
-        if (squaredDistance > node->maxSquaredRadius) {
+        if (squaredDistance > node.maxSquaredRadius) {
             return;
         }
-        if (node->hi < 0) {
-            update(node->lc, position, accumulate);
-            update(node->rc, position, accumulate);
+        if (node.hi < 0) {
+            update(node.lc, position, accumulate);
+            update(node.rc, position, accumulate);
         } else {
-            for (int i = node->lo; i < node->hi; ++i) {
-                if ((position - pixels[i]->hitPoint).squaredLength() <= pixels[i]->squaredRadius) {
-                    lock_guard<mutex> guard(kdlock);
-                    ++pixels[i]->incPhotons;
-                    // if (isnan(pixels[i]->flux.x())) {
-                    //     cerr << "Flux NaN!" << endl;
-                    //     cerr << pixels[i]->flux.x() << " " << pixels[i]->flux.y() << " " << pixels[i]->flux.z() << endl;
-                    // }
-                    pixels[i]->flux += pixels[i]->accumulate * accumulate;
-                    // if (isnan(pixels[i]->flux.x())) {
-                    //     cerr << "Flux NaN again!" << endl;
-                    //     cerr << pixels[i]->accumulate.x() << " " << pixels[i]->accumulate.y() << " " << pixels[i]->accumulate.z() << endl;
-                    //     cerr << accumulate.x() << " " << accumulate.y() << " " << accumulate.z() << endl;
-                    //     cerr << pixels[i]->flux.x() << " " << pixels[i]->flux.y() << " " << pixels[i]->flux.z() << endl;
-                    // }
-                    // float shrink = (pixels[i]->numPhotons + 1) * Constant::sppmAlpha / (pixels[i]->numPhotons * Constant::sppmAlpha + 1);
-                    // ++pixels[i]->numPhotons;
-                    // pixels[i]->squaredRadius *= shrink;
-                    // pixels[i]->flux = (pixels[i]->flux + pixels[i]->accumulate * accumulate) * shrink;
-                }
+            for (int i = node.lo; i < node.hi; ++i) {
+                deposit(i, position, accumulate);
             }
         }
     }
-    KDTreeNode *root;
-    Pixel **pixels;
-    mutex kdlock;
-    int size;
+    vector<KDTreeNode> nodes;
+    vector<int> leaves;
+    Pixel **scratch;
+    int *leafOf;
+    double builtCost;
+    int builtActive;
 };
 
 #endif
\ No newline at end of file
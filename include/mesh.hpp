@@ -1,14 +1,33 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <cstdint>
 #include <vector>
+#include "alias.hpp"
 #include "bvh.hpp"
 #include "object3d.hpp"
-#include "triangle.hpp"
 #include "utils.hpp"
 #include "Vector2f.h"
 #include "Vector3f.h"
 
+// Binary mesh cache (.cache next to the OBJ): a MeshCacheHeader, then the
+// triangle buffers of a Mesh in leaf order (positions, edges, normals,
+// texture and normal indices), the vt and vn lists and the BVH4 nodes.
+// It stands in for the OBJ while the OBJ keeps its size and modification
+// time and the BVH is built the same way.
+struct MeshCacheHeader {
+    char magic[4];
+    int32_t version;
+    int32_t triangles;
+    int32_t textures;
+    int32_t vertexNormals;
+    int32_t nodes;
+    int32_t sah;
+    int32_t reserved;
+    uint64_t objSize;
+    int64_t objTime;
+    float konta[3], makria[3];
+};
 
 class Mesh : public Object3D {
 
@@ -20,18 +39,46 @@ public:
             x[0] = r; x[1] = r; x[2] = r;
         }
         int &operator[](const int i) { return x[i]; }
+        const int &operator[](const int i) const { return x[i]; }
         // By Computer Graphics convention, counterclockwise winding is front face
         int x[3]{};
     };
 
     bool intersect(const Ray &r, Hit &h, float tmin) override;
 
+    unsigned intersectPacket(RayPacket &packet, Hit *hits, unsigned mask, float tmin) override;
+
+    // Shading attributes at the recorded barycentric (u, v) of a triangle.
+    void computeSurfaceInteraction(const Ray &r, Hit &h) override;
+
     Ray generateBeam(float time = 0) const override;
 
+    float getArea() const override {
+        return area;
+    }
+
 private:
-    std::vector<Triangle *> patches;
+    // Moller-Trumbore test against triangle i, accepting hits in [tmin, t].
+    bool intersectTriangle(int i, const float origin[3], const float direction[3], float tmin, float &t, float &u, float &v) const;
+    // Fills the buffers from a cache written for this OBJ; returns false if
+    // there is none or it is stale.
+    bool readCache(const char *filename, uint64_t objSize, int64_t objTime);
+    void saveCache(const char *filename, uint64_t objSize, int64_t objTime) const;
+    // Light sampling table and bounds, once the buffers are filled.
+    void finish();
+
+    // Triangles are stored in BVH leaf order as structure-of-arrays buffers:
+    // three floats per triangle for the first vertex, six for the two edges.
+    std::vector<float> positions, edges;
+    std::vector<Vector3f> normals;
+    // Attributes index into the OBJ's vt and vn lists, -1 where absent.
+    std::vector<TriangleIndex> textureIndices, normalIndices;
+    std::vector<Vector2f> textures;
+    std::vector<Vector3f> vertexNormals;
     BVH tree;
-    // Normal can be used for light estimation
+    // Beams leave triangles in proportion to their area.
+    AliasTable triangleTable;
+    float area;
 };
 
 #endif
@@ -40,14 +40,45 @@ public:
     // Intersect Ray with this object. If hit, store information in hit structure.
     virtual bool intersect(const Ray &r, Hit &h, float tmin) = 0;
 
+    // Intersects the rays of the packet in mask, hit i belonging to ray i,
+    // and returns the mask of rays hit. Objects without a packet traversal
+    // take the rays one at a time.
+    virtual unsigned intersectPacket(RayPacket &packet, Hit *hits, unsigned mask, float tmin) {
+        unsigned hit = 0;
+        for (int i = 0; i < packet.size; ++i) {
+            if (mask >> i & 1 && intersect(packet.rays[i], hits[i], tmin)) {
+                packet.tmax[i] = hits[i].getT();
+                hit |= 1u << i;
+            }
+        }
+        return hit;
+    }
+
+    // Second stage of intersect: material, normal and color of a hit this
+    // object recorded, r being the ray as intersect was given it.
+    virtual void computeSurfaceInteraction(const Ray &r, Hit &h) {}
+
     virtual Ray generateBeam(float time = 0) const {
         return Ray(Vector3f::ZERO, Vector3f::ZERO);
     }
+
+    // Emitting surface area, for sharing photons between lights. Objects
+    // that cannot emit beams have none.
+    virtual float getArea() const {
+        return 0;
+    }
 protected:
     bool isBounded;
 
     Material *material;
 };
 
+inline void Hit::computeSurfaceInteraction(const Ray &r) {
+    Object3D *shader = instance != nullptr ? instance : object;
+    if (shader != nullptr) {
+        shader->computeSurfaceInteraction(r, *this);
+    }
+}
+
 #endif
 
@@ -0,0 +1,31 @@
+#ifndef OPTION_H
+#define OPTION_H
+
+// Switches chosen on the command line, for comparing implementations.
+class Option {
+public:
+    static bool sah;
+    static bool hashGrid;
+    // Relative error below which a pixel stops being sampled; 0 samples
+    // every pixel every epoch.
+    static float adaptive;
+    // Eye pass tiles: their width in pixels and the order threads take
+    // them in.
+    enum TileOrder {
+        rowOrder,
+        mortonOrder,
+        hilbertOrder
+    };
+    static int tileSize;
+    static TileOrder tileOrder;
+    // Primary rays traced together as one packet: 4, 8 or 16, or 1 for
+    // single rays.
+    static int packetSize;
+    // Trace photons breadth first, a whole queue of them per bounce.
+    static bool wavefront;
+    // Keep a binary copy of every OBJ mesh, with its BVH, next to the OBJ
+    // and load that instead while the OBJ is unchanged.
+    static bool meshCache;
+};
+
+#endif
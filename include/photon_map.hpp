@@ -0,0 +1,166 @@
+#ifndef PHOTON_MAP_H
+#define PHOTON_MAP_H
+
+#include "image.hpp"
+#include "profiler.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <vector>
+
+// A photon landing on a diffuse surface, keyed by its place along a
+// Z-order curve so that batches of deposits can be applied in space order.
+struct PhotonDeposit {
+    uint32_t key;
+    Vector3f position, accumulate;
+};
+
+// Spatial index over the visible points of an epoch, which collects the
+// photons landing within each point's radius.
+class PhotonMap {
+public:
+    PhotonMap(Image &image): size(image.Width() * image.Height()), active(size), builds(0), gathered(0), starved(0) {
+        pixels = new Pixel*[size];
+        for (int i = 0; i < size; ++i) {
+            pixels[i] = image(i);
+        }
+        // Photon deposits land in packed arrays indexed like pixels, so
+        // threads only ever race on single words instead of a global lock.
+        // Flux is summed in fixed point, which makes the sum independent of
+        // the order in which threads deposit.
+        flux = new long long[size * 3]();
+        incPhotons = new int[size]();
+        // Deposits only read the position and radius of a visible point, so
+        // those are copied out of the pixels into flat arrays, in slot order.
+        hitX = new float[size];
+        hitY = new float[size];
+        hitZ = new float[size];
+        squaredRadius = new float[size];
+    }
+    virtual ~PhotonMap() {
+        delete[] pixels;
+        delete[] flux;
+        delete[] incPhotons;
+        delete[] hitX;
+        delete[] hitY;
+        delete[] hitZ;
+        delete[] squaredRadius;
+    }
+    // Indexes the visible points of the eye pass just finished.
+    virtual void construct() = 0;
+    // Deposits a photon on every visible point whose radius covers position.
+    virtual void update(const Vector3f &position, const Vector3f &accumulate) = 0;
+    // Deposits a batch in key order, so consecutive photons walk the same
+    // nodes and cells, and empties it. Deposits add up the same in any
+    // order.
+    void update(vector<PhotonDeposit> &batch) {
+        sortByKey(batch);
+        for (const PhotonDeposit &deposit : batch) {
+            update(deposit.position, deposit.accumulate);
+        }
+        batch.clear();
+    }
+    // Merges the deposits of an epoch into the pixels. The photon power
+    // summed per point is weighted by the point's throughput only here.
+    // The radiance the epoch alone estimates for a pixel is recorded too,
+    // and with a positive threshold pixels whose relative error fell below
+    // it are marked converged.
+    void merge(float threshold = 0) {
+        gathered = 0;
+        starved = 0;
+        for (int i = 0; i < active; ++i) {
+            Pixel *pixel = pixels[i];
+            gathered += incPhotons[i];
+            starved += incPhotons[i] == 0;
+            Vector3f epochFlux = pixel->accumulate * Vector3f(flux[i * 3] / fixedPoint, flux[i * 3 + 1] / fixedPoint, flux[i * 3 + 2] / fixedPoint);
+            pixel->record(Utils::luminance(epochFlux / (M_PI * pixel->squaredRadius * Constant::numPhotons) + pixel->direct));
+            if (threshold > 0 && pixel->samples >= Constant::minSamples && pixel->relativeError() < threshold) {
+                pixel->converged = true;
+            }
+            pixel->flux += epochFlux;
+            pixel->incPhotons += incPhotons[i];
+            flux[i * 3] = flux[i * 3 + 1] = flux[i * 3 + 2] = 0;
+            incPhotons[i] = 0;
+            pixel->update();
+        }
+    }
+    int getBuilds() const {
+        return builds;
+    }
+    // Photons gathered per visible point in the last merged epoch, and the
+    // share of points that gathered none.
+    float getGatheredPerPixel() const {
+        return active ? (float)gathered / active : 0;
+    }
+    float getStarvedShare() const {
+        return active ? (float)starved / active : 0;
+    }
+    // Share of the pixels left out of the map as converged.
+    float getConvergedShare() const {
+        return (float)(size - active) / size;
+    }
+    // Radix sort on the 30-bit keys, ten bits a pass.
+    static void sortByKey(vector<PhotonDeposit> &batch) {
+        static thread_local vector<PhotonDeposit> scratch;
+        scratch.resize(batch.size());
+        for (int shift = 0; shift < 30; shift += 10) {
+            int start[1025] = {0};
+            for (const PhotonDeposit &deposit : batch) {
+                ++start[(deposit.key >> shift & 1023) + 1];
+            }
+            for (int k = 0; k < 1024; ++k) {
+                start[k + 1] += start[k];
+            }
+            for (const PhotonDeposit &deposit : batch) {
+                scratch[start[deposit.key >> shift & 1023]++] = deposit;
+            }
+            batch.swap(scratch);
+        }
+    }
+protected:
+    // Moves the pixels still sampled to the front of the slots, keeping their
+    // order, so the map only indexes slots [0, active).
+    void select() {
+        active = stable_partition(pixels, pixels + size, [](const Pixel *pixel) {
+            return !pixel->converged;
+        }) - pixels;
+    }
+    // Copies the visible points out of the pixels, in the current slot order.
+    void gather() {
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < active; ++i) {
+            hitX[i] = pixels[i]->hitPoint.x();
+            hitY[i] = pixels[i]->hitPoint.y();
+            hitZ[i] = pixels[i]->hitPoint.z();
+            squaredRadius[i] = pixels[i]->squaredRadius;
+        }
+    }
+    void deposit(int i, const Vector3f &position, const Vector3f &accumulate) {
+        float dx = position.x() - hitX[i], dy = position.y() - hitY[i], dz = position.z() - hitZ[i];
+        if (dx * dx + dy * dy + dz * dz <= squaredRadius[i]) {
+            Profiler::count(Profiler::deposits);
+#pragma omp atomic
+            ++incPhotons[i];
+#pragma omp atomic
+            flux[i * 3] += toFixedPoint(accumulate.x());
+#pragma omp atomic
+            flux[i * 3 + 1] += toFixedPoint(accumulate.y());
+#pragma omp atomic
+            flux[i * 3 + 2] += toFixedPoint(accumulate.z());
+        }
+    }
+    static constexpr double fixedPoint = 1 << 24;
+    static long long toFixedPoint(float x) {
+        return (long long)(x * fixedPoint + 0.5);
+    }
+    Pixel **pixels;
+    long long *flux;
+    int *incPhotons;
+    float *hitX, *hitY, *hitZ, *squaredRadius;
+    int size;
+    int active;
+    int builds;
+    long long gathered;
+    int starved;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <omp.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// Wall-clock time per render phase and event counts, collected per epoch
+// and written as CSV, or as JSON when the log name ends in ".json".
+// Counting is off unless a log was asked for. Threads count into their
+// own cache lines, which are only summed when an epoch ends. A thread past
+// the slots opened for shares one, which the relaxed adds keep exact.
+class Profiler {
+public:
+    enum Phase {
+        eyePass,
+        mapBuild,
+        photonPass,
+        merge,
+        imageOutput,
+        checkpointOutput,
+        phaseCount
+    };
+    enum Counter {
+        rays,
+        photons,
+        deposits,
+        nodeVisits,
+        counterCount
+    };
+
+    // Opens the log; counting starts with the next epoch.
+    static void open(const char *filename) {
+        logName = filename;
+        slots.assign(omp_get_max_threads(), Slot());
+        enabled = true;
+    }
+
+    static void count(Counter counter, long long n = 1) {
+        if (enabled) {
+            Slot &slot = slots[omp_get_thread_num() % slots.size()];
+            __atomic_fetch_add(&slot.values[counter], n, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Times a phase from construction to destruction.
+    class Scope {
+    public:
+        explicit Scope(Phase phase): phase(phase), start(omp_get_wtime()) {}
+        ~Scope() {
+            current.seconds[phase] += omp_get_wtime() - start;
+        }
+    private:
+        Phase phase;
+        double start;
+    };
+
+    // Closes the record of an epoch and rewrites the log with every record
+    // so far.
+    static void endEpoch(int epoch) {
+        current.epoch = epoch;
+        for (size_t t = 0; t < slots.size(); ++t) {
+            for (int c = 0; c < counterCount; ++c) {
+                current.counts[c] += slots[t].values[c];
+                slots[t].values[c] = 0;
+            }
+        }
+        if (enabled) {
+            records.push_back(current);
+            write();
+        }
+        current = Record();
+    }
+
+    static const char *phaseName(int phase) {
+        static const char *names[] = {"eye_pass", "map_build", "photon_pass", "merge", "image_output", "checkpoint_output"};
+        return names[phase];
+    }
+
+    static const char *counterName(int counter) {
+        static const char *names[] = {"rays", "photons", "deposits", "node_visits"};
+        return names[counter];
+    }
+
+private:
+    // Padded to a cache line; vector storage is not over-aligned in C++11.
+    struct Slot {
+        long long values[counterCount];
+        char padding[64 - counterCount * sizeof(long long)];
+        Slot(): values() {}
+    };
+
+    struct Record {
+        int epoch;
+        double seconds[phaseCount];
+        long long counts[counterCount];
+        Record(): epoch(0), seconds(), counts() {}
+    };
+
+    static void write() {
+        FILE *file = fopen(logName, "w");
+        if (file == NULL) {
+            fprintf(stderr, "Cannot write file: %s\n", logName);
+            return;
+        }
+        size_t length = strlen(logName);
+        bool json = length >= 5 && !strcmp(logName + length - 5, ".json");
+        if (json) {
+            fprintf(file, "[\n");
+        } else {
+            fprintf(file, "epoch");
+            for (int p = 0; p < phaseCount; ++p) {
+                fprintf(file, ",%s_s", phaseName(p));
+            }
+            for (int c = 0; c < counterCount; ++c) {
+                fprintf(file, ",%s", counterName(c));
+            }
+            fprintf(file, "\n");
+        }
+        for (size_t r = 0; r < records.size(); ++r) {
+            const Record &record = records[r];
+            fprintf(file, json ? "  {\"epoch\": %d" : "%d", record.epoch);
+            for (int p = 0; p < phaseCount; ++p) {
+                if (json) {
+                    fprintf(file, ", \"%s_s\": %.6f", phaseName(p), record.seconds[p]);
+                } else {
+                    fprintf(file, ",%.6f", record.seconds[p]);
+                }
+            }
+            for (int c = 0; c < counterCount; ++c) {
+                if (json) {
+                    fprintf(file, ", \"%s\": %lld", counterName(c), record.counts[c]);
+                } else {
+                    fprintf(file, ",%lld", record.counts[c]);
+                }
+            }
+            fprintf(file, json ? (r + 1 < records.size() ? "},\n" : "}\n") : "\n");
+        }
+        if (json) {
+            fprintf(file, "]\n");
+        }
+        fclose(file);
+    }
+
+    static bool enabled;
+    static const char *logName;
+    static vector<Slot> slots;
+    static Record current;
+    static vector<Record> records;
+};
+
+#endif
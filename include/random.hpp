@@ -0,0 +1,66 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// PCG32 generator (O'Neill, pcg-random.org).
+// Every OpenMP thread owns one generator, and the passes re-key it per pixel
+// or per photon, so a run depends only on the seed and never on scheduling.
+class Random {
+public:
+    Random(uint64_t seed = 0, uint64_t stream = 0) {
+        set(seed, stream);
+    }
+
+    // The stream picks the increment, but PCG streams with nearby
+    // increments and the same state are visibly correlated, so the stream
+    // is hashed into the starting state too.
+    void set(uint64_t seed, uint64_t stream) {
+        state = 0;
+        inc = (stream << 1) | 1;
+        next();
+        state += mix(seed ^ stream);
+        next();
+    }
+
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+        uint32_t rot = old >> 59;
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+
+    // Uniform in [0, 1).
+    float uniform() {
+        return (next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    static Random &local() {
+        static thread_local Random rng;
+        return rng;
+    }
+
+    // Restart the calling thread's generator on the stream of a work item.
+    static void rekey(uint64_t key) {
+        local().set(seed(), key);
+    }
+
+    static uint64_t &seed() {
+        static uint64_t globalSeed = 0;
+        return globalSeed;
+    }
+
+protected:
+    // splitmix64 (Steele et al.), a bijection that scatters neighbouring keys.
+    static uint64_t mix(uint64_t z) {
+        z += 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t state, inc;
+};
+
+#endif
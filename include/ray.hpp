@@ -44,6 +44,41 @@ private:
 
 };
 
+// Up to maxSize rays traced together through a BVH, copied out in SoA form
+// so one SIMD slab test covers four of them. tmax holds each ray's closest
+// hit so far; unused lanes never hit anything.
+class RayPacket {
+public:
+    static const int maxSize = 16;
+
+    RayPacket(const Ray *rays, int size): rays(rays), size(size) {
+        for (int i = 0; i < maxSize; ++i) {
+            const Ray &ray = rays[i < size ? i : 0];
+            originX[i] = ray.getOrigin().x();
+            originY[i] = ray.getOrigin().y();
+            originZ[i] = ray.getOrigin().z();
+            directionX[i] = ray.getDirection().x();
+            directionY[i] = ray.getDirection().y();
+            directionZ[i] = ray.getDirection().z();
+            inverseX[i] = 1 / directionX[i];
+            inverseY[i] = 1 / directionY[i];
+            inverseZ[i] = 1 / directionZ[i];
+            tmax[i] = i < size ? 1e38 : -1;
+        }
+    }
+
+    unsigned fullMask() const {
+        return (1u << size) - 1;
+    }
+
+    const Ray *rays;
+    int size;
+    float originX[maxSize], originY[maxSize], originZ[maxSize];
+    float directionX[maxSize], directionY[maxSize], directionZ[maxSize];
+    float inverseX[maxSize], inverseY[maxSize], inverseZ[maxSize];
+    float tmax[maxSize];
+};
+
 inline std::ostream &operator<<(std::ostream &os, const Ray &r) {
     os << "Ray <" << r.getOrigin() << ", " << r.getDirection() << ">";
     return os;
@@ -45,15 +45,24 @@ public:
             if (!methodNewton(r, tEnter, tau, theta, normal, point) || !isnormal(tEnter) || !isnormal(tau) || !isnormal(theta) || tEnter < tmin || tEnter >= h.getT() || tau < pCurve->lowerBound || tau > pCurve->upperBound) {
                 return false;
             }
-            float u = theta / (2 * M_PI);
-            float v = (tau - pCurve->lowerBound) / (pCurve->upperBound - pCurve->lowerBound);
-            h.set(tEnter, material, getNormal(normal, u, v), material->getColor(u, v));
+            h.record(tEnter, this, 0, tau, theta);
             return true;
         } else {
             return false;
         }
     }
 
+    // The normal is the one Newton's method ended on, at (tau, theta).
+    void computeSurfaceInteraction(const Ray &r, Hit &h) override {
+        float tau = h.getU(), theta = h.getV();
+        Vector3f point, parTau, parTheta;
+        getRevSurfacePoint(tau, theta, point, parTau, parTheta);
+        Vector3f normal = Vector3f::cross(parTau, parTheta);
+        float u = theta / (2 * M_PI);
+        float v = (tau - pCurve->lowerBound) / (pCurve->upperBound - pCurve->lowerBound);
+        h.set(h.getT(), material, getNormal(normal, u, v), material->getColor(u, v));
+    }
+
 protected:
     void getRevSurfacePoint(float tau, float theta, Vector3f &point, Vector3f &parTau, Vector3f &parTheta) {
         Quat4f rot;
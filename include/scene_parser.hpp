@@ -2,6 +2,9 @@
 #define SCENE_PARSER_H
 
 #include <cassert>
+#include <map>
+#include <string>
+#include <utility>
 #include <vecmath.h>
 
 class Camera;
@@ -16,6 +19,7 @@ class Disk;
 class Triangle;
 class Transform;
 class Mesh;
+class Texture;
 class Curve;
 class RevSurface;
 
@@ -69,6 +73,7 @@ private:
     Light *parseDirectionalLight();
     void parseMaterials();
     Material *parseMaterial();
+    Texture *loadTexture(const char *filename);
     Object3D *parseObject(char token[MAX_PARSER_TOKEN_LENGTH]);
     Group *parseGroup();
     Sphere *parseSphere();
@@ -77,7 +82,8 @@ private:
     Disk *parseDisk();
     Triangle *parseTriangle();
     Mesh *parseTriangleMesh();
-    Transform *parseTransform();
+    Object3D *parseTransform();
+    Object3D *flatten(const Matrix4f &matrix, Object3D *object);
     Curve *parseBezierCurve();
     Curve *parseBsplineCurve();
     RevSurface *parseRevSurface();
@@ -98,6 +104,12 @@ private:
     Material **materials;
     Material *current_material;
     Group *group;
+    // Meshes already loaded, by OBJ file and material. Repeated
+    // TriangleMesh blocks share one Mesh and its BVH, each Transform around
+    // them being an instance.
+    std::map<std::pair<std::string, Material *>, Mesh *> meshes;
+    // Textures by file, shared by every material that names the file.
+    std::map<std::string, Texture *> textures;
 
     float tStart, tEnd;
 };
@@ -25,6 +25,10 @@ public:
 
     virtual Vector3f getCenter(float time) = 0;
 
+    float getRadius() const {
+        return radius;
+    }
+
     bool intersect(const Ray &r, Hit &h, float tmin) override {
         Vector3f tCenter = getCenter(r.getTime());
         float rayDirectionLength = r.getDirection().length();
@@ -45,11 +49,16 @@ public:
         if (t > h.getT() || t < tmin) {
             return false;
         }
-        Vector3f normal = (r.pointAtParameter(t) - tCenter).normalized();
+        h.record(t, this);
+        return true;
+    }
+
+    void computeSurfaceInteraction(const Ray &r, Hit &h) override {
+        float t = h.getT();
+        Vector3f normal = (r.pointAtParameter(t) - getCenter(r.getTime())).normalized();
         float u = atan2(normal.x(), normal.z()) / (2 * M_PI) + 0.5;
         float v = -asin(normal.y()) / M_PI + 0.5;
         h.set(t, material, getNormal(normal, u, v), material->getColor(u, v));
-        return true;
     }
 
     Ray generateBeam(float time = 0) const override {
@@ -63,6 +72,10 @@ public:
         return Ray(center + radius * dir, dir, time);
     }
 
+    float getArea() const override {
+        return 4 * M_PI * radius * radius;
+    }
+
 protected:
     Vector3f center;
     float radius;
@@ -1,22 +1,31 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
-#include "image.hpp"
+#include <cstdint>
+#include <vector>
+#include <vecmath.h>
 
 using namespace std;
 
+// An 8-bit RGB image for lookups, stored as RGBA in 4x4 tiles: texels
+// row-major within a tile, tiles row-major across the image. A tile fills
+// one aligned 64-byte line, so the four texels of a bilinear lookup share a
+// line unless they straddle a tile edge. Colors come out as the byte over
+// 255, as they were decoded before.
 class Texture {
 public:
-    Texture(const char *filename): image(filename) {
-        width = image.Width();
-        height = image.Height();
-    }
-    Vector3f getPixel(int x, int y) {
+    explicit Texture(const char *filename);
+
+    Texture(const Texture &) = delete;
+    Texture &operator=(const Texture &) = delete;
+
+    Vector3f getPixel(int x, int y) const {
         x = x < 0 ? 0 : (x >= width ? (width - 1) : x);
         y = y < 0 ? 0 : (y >= height ? (height - 1) : y);
-        return image.GetPixel(x, y);
+        const uint8_t *texel = texels + texelIndex(x, y) * 4;
+        return Vector3f(unit[texel[0]], unit[texel[1]], unit[texel[2]]);
     }
-    Vector3f getColor(float u, float v) {
+    Vector3f getColor(float u, float v) const {
         // u -= int(u);
         // v -= int(v);
         // if (u < 0) u += 1;
@@ -32,9 +41,24 @@ public:
         ret += alpha * beta * getPixel(x + 1, y + 1);
         return ret;
     }
+    int getWidth() const {
+        return width;
+    }
+    int getHeight() const {
+        return height;
+    }
 protected:
-    Image image;
-    int width, height;
+    static const int tileSize = 4;
+    size_t texelIndex(int x, int y) const {
+        size_t tile = (size_t)(y / tileSize) * tilesPerRow + x / tileSize;
+        return tile * tileSize * tileSize + (y % tileSize) * tileSize + x % tileSize;
+    }
+    int width, height, tilesPerRow;
+    // texels points into storage at the first 64-byte boundary.
+    vector<uint8_t> storage;
+    uint8_t *texels;
+    // Byte values as floats.
+    static float unit[256];
 };
 
-#endif
\ No newline at end of file
+#endif
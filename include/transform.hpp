@@ -10,18 +10,27 @@ static Vector3f transformPoint(const Matrix4f &mat, const Vector3f &point) {
     return (mat * Vector4f(point, 1)).xyz();
 }
 
-// transform a 3D directino using a matrix, returning a direction
-static Vector3f transformDirection(const Matrix4f &mat, const Vector3f &dir) {
-    return (mat * Vector4f(dir, 0)).xyz();
-}
-
-// TODO: implement this class so that the intersect function first transforms the ray
+// Intersects an object placed by an affine matrix: rays go into object space
+// through the inverse, normals come back through its transpose. Both are
+// kept as plain rows, the inverse as 3x4 since its last row is 0 0 0 1.
 class Transform : public Object3D {
 public:
     Transform() {}
 
-    Transform(const Matrix4f &m, Object3D *obj) : o(obj) {
-        transform = m.inverse();
+    Transform(const Matrix4f &m, Object3D *obj) : o(obj), matrix(m) {
+        Matrix4f inverse = m.inverse();
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                worldToObject[i * 4 + j] = inverse(i, j);
+            }
+            for (int j = 0; j < 3; ++j) {
+                normalMatrix[i * 3 + j] = inverse(j, i);
+            }
+        }
+        // Objects without bounds, like planes, stay without bounds.
+        if (!o->bounded()) {
+            return;
+        }
         Vector3f vertices[8] = {
             Vector3f(o->konta.x() , o->konta.y() , o->konta.z() ),
             Vector3f(o->konta.x() , o->konta.y() , o->makria.z()),
@@ -32,7 +41,7 @@ public:
             Vector3f(o->makria.x(), o->makria.y(), o->konta.z() ),
             Vector3f(o->makria.x(), o->makria.y(), o->makria.z())
         };
-        Vector3f konta(0), makria(0);
+        Vector3f konta(1e38), makria(-1e38);
         for (int i = 0; i < 8; ++i) {
             Vector3f vertex = transformPoint(m, vertices[i]);
             konta = Utils::min(konta, vertex);
@@ -44,20 +53,66 @@ public:
     ~Transform() {
     }
 
-    virtual bool intersect(const Ray &r, Hit &h, float tmin) {
-        Vector3f trSource = transformPoint(transform, r.getOrigin());
-        Vector3f trDirection = transformDirection(transform, r.getDirection());
-        Ray tr(trSource, trDirection);
-        bool inter = o->intersect(tr, h, tmin);
-        if (inter) {
-            h.set(h.getT(), h.getMaterial(), transformDirection(transform.transposed(), h.getNormal()).normalized(), h.getColor());
+    bool intersect(const Ray &r, Hit &h, float tmin) override {
+        Ray tr = toObject(r);
+        if (!o->intersect(tr, h, tmin)) {
+            return false;
         }
-        return inter;
+        // A hit waits on one transform at most, so one that a transform
+        // inside this one claimed is shaded now.
+        if (h.getInstance() != nullptr) {
+            h.getInstance()->computeSurfaceInteraction(tr, h);
+        }
+        if (h.getObject() == nullptr) {
+            h.setNormal(toWorld(h.getNormal()));
+        } else {
+            h.setInstance(this);
+        }
+        return true;
+    }
+
+    void computeSurfaceInteraction(const Ray &r, Hit &h) override {
+        h.getObject()->computeSurfaceInteraction(toObject(r), h);
+        h.setNormal(toWorld(h.getNormal()));
+    }
+
+    const Matrix4f &getMatrix() const {
+        return matrix;
+    }
+
+    Object3D *getObject() const {
+        return o;
     }
 
 protected:
+    Ray toObject(const Ray &r) const {
+        const Vector3f &origin = r.getOrigin(), &direction = r.getDirection();
+        const float *m = worldToObject;
+        return Ray(Vector3f(
+            m[0] * origin.x() + m[1] * origin.y() + m[2] * origin.z() + m[3],
+            m[4] * origin.x() + m[5] * origin.y() + m[6] * origin.z() + m[7],
+            m[8] * origin.x() + m[9] * origin.y() + m[10] * origin.z() + m[11]
+        ), Vector3f(
+            m[0] * direction.x() + m[1] * direction.y() + m[2] * direction.z(),
+            m[4] * direction.x() + m[5] * direction.y() + m[6] * direction.z(),
+            m[8] * direction.x() + m[9] * direction.y() + m[10] * direction.z()
+        ), r.getTime());
+    }
+
+    // Normal in world space, normalized.
+    Vector3f toWorld(const Vector3f &n) const {
+        const float *m = normalMatrix;
+        return Vector3f(
+            m[0] * n.x() + m[1] * n.y() + m[2] * n.z(),
+            m[3] * n.x() + m[4] * n.y() + m[5] * n.z(),
+            m[6] * n.x() + m[7] * n.y() + m[8] * n.z()
+        ).normalized();
+    }
+
     Object3D *o; //un-transformed object
-    Matrix4f transform;
+    Matrix4f matrix;
+    float worldToObject[12];
+    float normalMatrix[9];
 };
 
 #endif //TRANSFORM_H
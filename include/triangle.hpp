@@ -53,17 +53,22 @@ public:
 		if (t <= 0 || beta < 0 || beta > 1 || gamma < 0 || gamma > 1 || beta + gamma > 1 || t > hit.getT() || t < tmin) {
 			return false;
 		}
+		hit.record(t, this, 0, beta, gamma);
+		return true;
+	}
+
+	void computeSurfaceInteraction(const Ray &ray, Hit &hit) override {
+		float t = hit.getT();
 		Vector3f p(ray.pointAtParameter(t));
 		Vector3f pa(vertices[0] - p), pb(vertices[1] - p), pc(vertices[2] - p);
 		float s1 = Vector3f::cross(pb, pc).length();
 		float s2 = Vector3f::cross(pc, pa).length();
 		float s3 = Vector3f::cross(pa, pb).length();
-		Vector2f uv(beta, gamma);
+		Vector2f uv(hit.getU(), hit.getV());
 		if (hasTexture) {
 			uv = (s1 * textures[0] + s2 * textures[1] + s3 * textures[2]) / (s1 + s2 + s3);
 		}
 		hit.set(t, material, hasNormal ? (s1 * normals[0] + s2 * normals[1] + s3 * normals[2]).normalized() : getNormal(normal, uv.x(), 1 - uv.y()), material->getColor(uv.x(), 1 - uv.y()));
-		return true;
 	}
 
 	Vector3f getCenter() {
@@ -78,6 +83,9 @@ public:
 		}
 		return Ray((1 - rb - rc) * vertices[0] + rb * vertices[1] + rc * vertices[2], Utils::sampleReflectedRay(normal), time);
 	}
+	float getArea() const override {
+		return Vector3f::cross(edges[0], edges[1]).length() / 2;
+	}
 	Vector3f normal;
 	Vector3f vertices[3];
 	Vector2f textures[3];
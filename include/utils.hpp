@@ -1,11 +1,13 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-#include <random>
 #include <vecmath.h>
+#include <algorithm>
+#include "random.hpp"
 #include <string>
 #include <sstream>
 #include <functional>
+#include <vector>
 
 using namespace std;
 
@@ -16,9 +18,7 @@ public:
     }
 
     static float randomEngine() {
-        static std::mt19937 rng(std::random_device{}());
-        static std::uniform_real_distribution<float> u(0.0, 1.0);
-        return u(rng);
+        return Random::local().uniform();
     }
     static float randomEngine(float lo, float hi) {
         return lo + randomEngine() * (hi - lo);
@@ -48,6 +48,9 @@ public:
     static float max(const Vector3f &f) {
         return (f.x() > f.y() && f.x() > f.z()) ? f.x() : (f.y() > f.z() ? f.y() : f.z());
     }
+    static float luminance(const Vector3f &f) {
+        return 0.2126f * f.x() + 0.7152f * f.y() + 0.0722f * f.z();
+    }
     static Vector3f min(const Vector3f &a, const Vector3f &b) {
         return Vector3f(::min(a.x(), b.x()), ::min(a.y(), b.y()), ::min(a.z(), b.z()));
     }
@@ -86,6 +89,42 @@ public:
         return (u * cos(r1) * r2s + v * sin(r1) * r2s + w * sqrt(1 - r2)).normalized();
     }
 
+    // Position of (x, y) along the Z-order curve.
+    static uint32_t morton(uint32_t x, uint32_t y) {
+        uint32_t code = 0;
+        for (int bit = 0; bit < 16; ++bit) {
+            code |= (x >> bit & 1) << (2 * bit) | (y >> bit & 1) << (2 * bit + 1);
+        }
+        return code;
+    }
+
+    // Position of (x, y, z) along the Z-order curve, ten bits per axis.
+    static uint32_t morton(uint32_t x, uint32_t y, uint32_t z) {
+        uint32_t code = 0;
+        for (int bit = 0; bit < 10; ++bit) {
+            code |= (x >> bit & 1) << (3 * bit) | (y >> bit & 1) << (3 * bit + 1) | (z >> bit & 1) << (3 * bit + 2);
+        }
+        return code;
+    }
+
+    // Position of (x, y) along the Hilbert curve filling an n x n square,
+    // n a power of two.
+    static uint32_t hilbert(uint32_t n, uint32_t x, uint32_t y) {
+        uint32_t d = 0;
+        for (uint32_t s = n / 2; s > 0; s /= 2) {
+            uint32_t rx = (x & s) > 0, ry = (y & s) > 0;
+            d += s * s * ((3 * rx) ^ ry);
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
     static void stringSplit(string str, char split, vector<string> &res) {
         istringstream iss(str);
         string token;
@@ -5,8 +5,19 @@ const int Constant::traceThreshold = 20;
 const int Constant::russianRoulette = 5;
 const float Constant::tmin = 1e-2;
 const int Constant::bvhmax = 5;
+const int Constant::bvhLeafMax = 16;
+const float Constant::bvhTraversalCost = 0.5;
 const int Constant::kdmax = 5;
+const float Constant::kdRefitTolerance = 1.5;
 const float Constant::strongPhos = 1000;
 const float Constant::squaredRadius = 1e-1;
+const float Constant::initialRadiusPixels = 2.5;
+const float Constant::maxRadiusFraction = 0.02;
+const float Constant::starvedGrowth = 2;
+const float Constant::targetPhotons = 2;
 const int Constant::numPhotons = 200000;
+const int Constant::wavefrontSize = 1 << 16;
+const int Constant::depositBatch = 4096;
+const int Constant::minSamples = 16;
+const float Constant::adaptiveFloor = 1e-3;
 const float Constant::tangentScale = 5;
\ No newline at end of file
@@ -1,6 +1,12 @@
 #include <cstdlib>
 #include <cstdio>
+#include <cstddef>
 #include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -9,6 +15,8 @@
 #include "stb_image.h"
 #include "stb_image_write.h"
 
+float Pixel::maxSquaredRadius = 1e30;
+
 Image::Image(int w, int h): width(w), height(h), data(new Pixel[w * h]) {}
 
 Image::Image(const char *filename) {
@@ -342,7 +350,94 @@ void Image::SaveImage(const char * filename)
 	}
 }
 
-void Image::readPixels(const char *filename) {
+static const char pixelMagic[4] = {'P', 'X', 'L', '\0'};
+
+bool Image::readPixels(const char *filename, int &epoch, uint64_t &seed) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open file: %s\n", filename);
+        exit(1);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = st.st_size;
+    void *map = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map file: %s\n", filename);
+        exit(1);
+    }
+    if (size < sizeof(PixelHeader) || memcmp(map, pixelMagic, 4)) {
+        munmap(map, size);
+        readTextPixels(filename, epoch);
+        return false;
+    }
+    const PixelHeader *header = (const PixelHeader *)map;
+    size_t recordSize = header->version == 1 ? offsetof(PixelRecord, samples) : sizeof(PixelRecord);
+    if (header->version < 1 || header->version > pixelVersion || header->width != width || header->height != height ||
+        size != sizeof(PixelHeader) + recordSize * width * height) {
+        fprintf(stderr, "Incompatible checkpoint: %s (version %d, %dx%d)\n", filename, header->version, header->width, header->height);
+        exit(1);
+    }
+    const char *records = (const char *)(header + 1);
+    for (int i = 0; i < width * height; ++i) {
+        const PixelRecord &record = *(const PixelRecord *)(records + recordSize * i);
+        Pixel &p = data[i];
+        p.flux = Vector3f(record.flux[0], record.flux[1], record.flux[2]);
+        p.phos = Vector3f(record.phos[0], record.phos[1], record.phos[2]);
+        p.numPhotons = record.numPhotons;
+        p.squaredRadius = record.squaredRadius;
+        if (header->version == 1) {
+            p.samples = header->epoch;
+            continue;
+        }
+        p.samples = record.samples;
+        p.converged = record.converged;
+        p.mean = record.mean;
+        p.m2 = record.m2;
+    }
+    epoch = header->epoch;
+    seed = header->seed;
+    munmap(map, size);
+    return true;
+}
+
+void Image::SavePixels(const char *filename, int epoch, uint64_t seed) {
+    std::vector<char> buffer(sizeof(PixelHeader) + sizeof(PixelRecord) * width * height);
+    PixelHeader *header = (PixelHeader *)buffer.data();
+    memcpy(header->magic, pixelMagic, 4);
+    header->version = pixelVersion;
+    header->width = width;
+    header->height = height;
+    header->epoch = epoch;
+    header->reserved = 0;
+    header->seed = seed;
+    PixelRecord *records = (PixelRecord *)(header + 1);
+    for (int i = 0; i < width * height; ++i) {
+        Pixel &p = data[i];
+        for (int k = 0; k < 3; ++k) {
+            records[i].flux[k] = p.flux[k];
+            records[i].phos[k] = p.phos[k];
+        }
+        records[i].numPhotons = p.numPhotons;
+        records[i].squaredRadius = p.squaredRadius;
+        records[i].samples = p.samples;
+        records[i].converged = p.converged;
+        records[i].mean = p.mean;
+        records[i].m2 = p.m2;
+    }
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL || fwrite(buffer.data(), buffer.size(), 1, file) != 1) {
+        fprintf(stderr, "Cannot write file: %s\n", filename);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+}
+
+// Checkpoints written before the binary format: per pixel, column by column,
+// the flux, an optional "p"-tagged phos, the photon count and the radius.
+void Image::readTextPixels(const char *filename, int epoch) {
     std::ifstream ifs(filename);
     if (!ifs) {
         fprintf(stderr, "Cannot open file: %s", filename);
@@ -359,25 +454,8 @@ void Image::readPixels(const char *filename) {
             }
             ifs >> p.numPhotons;
             ifs >> p.squaredRadius;
+            p.samples = epoch;
         }
     }
     ifs.close();
 }
-
-void Image::SavePixels(const char *filename) {
-    std::ofstream ofs(filename, std::ios::trunc);
-    for (int x = 0; x < width; ++x) {
-        for (int y = 0; y < height; ++y) {
-            Pixel &p = data[y * width + x];
-            ofs << p.flux.x() << "\t" << p.flux.y() << "\t" << p.flux.z() << std::endl;
-            if (p.phos.squaredLength() > 0) {
-                ofs << "p\t" << p.phos.x() << "\t" << p.phos.y() << "\t" << p.phos.z() << std::endl;
-            } else {
-                ofs << "s" << std::endl;
-            }
-            ofs << p.numPhotons << std::endl;
-            ofs << p.squaredRadius << std::endl;
-        }
-    }
-    ofs.close();
-}
@@ -1,4 +1,5 @@
 #include "chroma.hpp"
+#include <random>
 
 using namespace std;
 
@@ -7,10 +8,52 @@ int main(int argc, char *argv[]) {
         std::cout << "Argument " << argNum << " is: " << argv[argNum] << std::endl;
     }
 
-    if (argc != 3) {
-        cout << "Usage: ./bin/PA1 <input scene file> <output bmp file>" << endl;
+    bool benchmark = false;
+    int epochs = 2000, checkpoint = 50, resume = 0;
+    const char *convertFile = nullptr;
+    Random::seed() = random_device{}();
+    for (int argNum = 3; argNum < argc; ++argNum) {
+        if (!strcmp(argv[argNum], "--bench")) {
+            benchmark = true;
+        } else if (!strcmp(argv[argNum], "--seed") && argNum + 1 < argc) {
+            Random::seed() = strtoull(argv[++argNum], nullptr, 10);
+        } else if (!strcmp(argv[argNum], "--epochs") && argNum + 1 < argc) {
+            epochs = atoi(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "--checkpoint") && argNum + 1 < argc) {
+            checkpoint = atoi(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "--resume") && argNum + 1 < argc) {
+            resume = atoi(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "--convert") && argNum + 1 < argc) {
+            convertFile = argv[++argNum];
+        } else if (!strcmp(argv[argNum], "--bvh") && argNum + 1 < argc) {
+            Option::sah = strcmp(argv[++argNum], "median") != 0;
+        } else if (!strcmp(argv[argNum], "--photon-map") && argNum + 1 < argc) {
+            Option::hashGrid = strcmp(argv[++argNum], "kdtree") != 0;
+        } else if (!strcmp(argv[argNum], "--adaptive") && argNum + 1 < argc) {
+            Option::adaptive = atof(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "--tile") && argNum + 1 < argc) {
+            Option::tileSize = max(1, atoi(argv[++argNum]));
+        } else if (!strcmp(argv[argNum], "--tile-order") && argNum + 1 < argc) {
+            const char *order = argv[++argNum];
+            Option::tileOrder = !strcmp(order, "row") ? Option::rowOrder : !strcmp(order, "morton") ? Option::mortonOrder : Option::hilbertOrder;
+        } else if (!strcmp(argv[argNum], "--profile") && argNum + 1 < argc) {
+            Profiler::open(argv[++argNum]);
+        } else if (!strcmp(argv[argNum], "--wavefront")) {
+            Option::wavefront = true;
+        } else if (!strcmp(argv[argNum], "--mesh-cache")) {
+            Option::meshCache = true;
+        } else if (!strcmp(argv[argNum], "--packet") && argNum + 1 < argc) {
+            int size = atoi(argv[++argNum]);
+            Option::packetSize = size >= 16 ? 16 : size >= 8 ? 8 : size >= 4 ? 4 : 1;
+        } else {
+            argc = 0;
+        }
+    }
+    if (argc < 3) {
+        cout << "Usage: ./bin/PA1 <input scene file> <output bmp file> [--bench] [--seed <n>] [--epochs <n>] [--checkpoint <n>] [--resume <epoch>] [--convert <pxl file>] [--bvh sah|median] [--photon-map grid|kdtree] [--adaptive <relative error>] [--tile <pixels>] [--tile-order hilbert|morton|row] [--packet 1|4|8|16] [--wavefront] [--mesh-cache] [--profile <log.csv|log.json>]" << endl;
         return 1;
     }
+    cout << "Seed: " << Random::seed() << endl;
     string inputFile = argv[1];
     string outputFile = argv[2];
 
@@ -19,9 +62,25 @@ int main(int argc, char *argv[]) {
         sceneParser.getCamera()->getWidth(), 
         sceneParser.getCamera()->getHeight()
     );
+    if (convertFile) {
+        // Rewrite a text checkpoint in the binary format, taking the epoch
+        // from its checkpoint-<epoch>.pxl name.
+        const char *base = strrchr(convertFile, '/');
+        int epoch = 0;
+        uint64_t seed = Random::seed();
+        sscanf(base ? base + 1 : convertFile, "checkpoint-%d.pxl", &epoch);
+        image.readPixels(convertFile, epoch, seed);
+        image.SavePixels(convertFile, epoch, seed);
+        cout << "Converted " << convertFile << " (epoch " << epoch << ")" << endl;
+        return 0;
+    }
     Chroma chroma(sceneParser, image);
+    if (benchmark) {
+        chroma.benchmark();
+        return 0;
+    }
     // chroma.render(10, 1, false, 0);
-    chroma.render(2000, 50, true, 0);
+    chroma.render(epochs, checkpoint, true, resume);
     image.SaveImage(outputFile.c_str());
     cout << "Hello! Computer Graphics!" << endl;
     return 0;
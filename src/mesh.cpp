@@ -2,106 +2,570 @@
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <string>
 #include <utility>
-#include <sstream>
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 bool Mesh::intersect(const Ray &r, Hit &h, float tmin) {
+    const Vector3f &o = r.getOrigin(), &d = r.getDirection();
+    float origin[3] = {o.x(), o.y(), o.z()};
+    float direction[3] = {d.x(), d.y(), d.z()};
+    float t = h.getT(), u = 0, v = 0;
+    int closest = -1;
+    tree.intersect(r, t, [&](int i) {
+        if (intersectTriangle(i, origin, direction, tmin, t, u, v)) {
+            closest = i;
+            return true;
+        }
+        return false;
+    });
+    if (closest < 0) {
+        return false;
+    }
+    h.record(t, this, closest, u, v);
+    return true;
+}
+
+unsigned Mesh::intersectPacket(RayPacket &packet, Hit *hits, unsigned mask, float tmin) {
+    float u[RayPacket::maxSize], v[RayPacket::maxSize];
+    int closest[RayPacket::maxSize];
+    std::fill(closest, closest + RayPacket::maxSize, -1);
+    unsigned hit = tree.intersectPacket(packet, mask, [&](int i, unsigned rays) {
+        unsigned found = 0;
+        for (int j = 0; j < packet.size; ++j) {
+            if (!(rays >> j & 1)) {
+                continue;
+            }
+            float origin[3] = {packet.originX[j], packet.originY[j], packet.originZ[j]};
+            float direction[3] = {packet.directionX[j], packet.directionY[j], packet.directionZ[j]};
+            if (intersectTriangle(i, origin, direction, tmin, packet.tmax[j], u[j], v[j])) {
+                closest[j] = i;
+                found |= 1u << j;
+            }
+        }
+        return found;
+    });
+    for (int j = 0; j < packet.size; ++j) {
+        if (hit >> j & 1) {
+            hits[j].record(packet.tmax[j], this, closest[j], u[j], v[j]);
+        }
+    }
+    return hit;
+}
+
+bool Mesh::intersectTriangle(int i, const float origin[3], const float direction[3], float tmin, float &t, float &u, float &v) const {
+    const float *v0 = &positions[i * 3], *e1 = &edges[i * 6], *e2 = &edges[i * 6 + 3];
+    float p[3] = {
+        direction[1] * e2[2] - direction[2] * e2[1],
+        direction[2] * e2[0] - direction[0] * e2[2],
+        direction[0] * e2[1] - direction[1] * e2[0]
+    };
+    float determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (determinant == 0) {
+        return false;
+    }
+    float inverse = 1 / determinant;
+    float s[3] = {origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2]};
+    float beta = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+    if (beta < 0 || beta > 1) {
+        return false;
+    }
+    float q[3] = {
+        s[1] * e1[2] - s[2] * e1[1],
+        s[2] * e1[0] - s[0] * e1[2],
+        s[0] * e1[1] - s[1] * e1[0]
+    };
+    float gamma = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+    if (gamma < 0 || beta + gamma > 1) {
+        return false;
+    }
+    float tHit = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+    if (tHit <= 0 || tHit > t || tHit < tmin) {
+        return false;
+    }
+    t = tHit;
+    u = beta;
+    v = gamma;
+    return true;
+}
+
+void Mesh::computeSurfaceInteraction(const Ray &r, Hit &h) {
+    int i = h.getPrimitive();
+    float u = h.getU(), v = h.getV(), w = 1 - u - v;
+    Vector2f uv(u, v);
+    const TriangleIndex &tex = textureIndices[i];
+    if (tex[0] >= 0) {
+        uv = w * textures[tex[0]] + u * textures[tex[1]] + v * textures[tex[2]];
+    }
+    Vector3f normal;
+    const TriangleIndex &nor = normalIndices[i];
+    if (nor[0] >= 0) {
+        normal = (w * vertexNormals[nor[0]] + u * vertexNormals[nor[1]] + v * vertexNormals[nor[2]]).normalized();
+    } else if (material->hasNormal()) {
+        Vector3f bump = material->getNormal(uv.x(), 1 - uv.y());
+        Vector3f tangent = Utils::generateVertical(normals[i]);
+        Vector3f binormal = Vector3f::cross(bump, tangent).normalized();
+        normal = (tangent * bump.x() * Constant::tangentScale + binormal * bump.y() * Constant::tangentScale + normals[i] * bump.z()).normalized();
+    } else {
+        normal = normals[i];
+    }
+    h.set(h.getT(), material, normal, material->getColor(uv.x(), 1 - uv.y()));
+}
+
+// The OBJ scanner below reads straight from the mapped file. Every scan
+// stops at end, since the last line need not end in a newline.
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+static const char *scanInt(const char *p, const char *end, int &value) {
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        ++p;
+    }
+    const char *digits = p;
+    int n = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        n = n * 10 + (*p++ - '0');
+    }
+    if (p == digits) {
+        return nullptr;
+    }
+    value = negative ? -n : n;
+    return p;
+}
 
-    // Optional: Change this brute force method into a faster one.
-    // bool result = false;
-    // for (int triId = 0; triId < (int) patches.size(); ++triId) {
-    //     Triangle *tria = patches[triId];
-    //     result |= tria->intersect(r, h, tmin);
-    // }
-    // return result;
-    return tree.intersect(r, h, tmin);
+// Decimal floats as exporters write them: [sign]digits[.digits][e[sign]digits].
+// When the digits fit in 24 bits and the power of ten is at most 10, the
+// mantissa and the power are both exact floats, so one float multiply or
+// divide rounds correctly. Anything else goes to strtof, since going through
+// a double would round twice.
+static const char *scanFloat(const char *p, const char *end, float &value) {
+    static const float powers[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+    };
+    const char *start = p;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int significant = 0, exponent = 0, digits = 0;
+    for (bool fraction = false; p < end; ++p) {
+        if (*p == '.' && !fraction) {
+            fraction = true;
+            continue;
+        }
+        if (*p < '0' || *p > '9') {
+            break;
+        }
+        ++digits;
+        if (mantissa != 0 || *p != '0') {
+            ++significant;
+        }
+        if (significant <= 15) {
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent -= fraction;
+        } else {
+            exponent += !fraction;
+        }
+    }
+    if (digits == 0) {
+        return nullptr;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int power;
+        const char *after = scanInt(p + 1, end, power);
+        if (after != nullptr) {
+            exponent += power;
+            p = after;
+        }
+    }
+    if (significant <= 15 && mantissa < (1u << 24) && exponent >= -10 && exponent <= 10) {
+        float x = exponent < 0 ? (float)mantissa / powers[-exponent] : (float)mantissa * powers[exponent];
+        value = negative ? -x : x;
+        return p;
+    }
+    char buffer[64];
+    size_t length = min<size_t>(p - start, sizeof(buffer) - 1);
+    memcpy(buffer, start, length);
+    buffer[length] = '\0';
+    value = strtof(buffer, nullptr);
+    return p;
 }
 
-Mesh::Mesh(const char *filename, Material *material) : Object3D(material), patches(0), tree() {
+// The vertices, attributes and faces read from a run of whole lines.
+// Face indices are absolute in the OBJ, so chunks read independently and
+// are joined in file order.
+struct ObjChunk {
+    vector<Vector3f> v, vn;
+    vector<Vector2f> vt;
+    vector<Mesh::TriangleIndex> t, text, norm;
+};
 
-    // Optional: Use tiny obj loader to replace this simple one.
-    std::ifstream f;
-    f.open(filename);
-    if (!f.is_open()) {
+// Reads the lines starting in [begin, end). Only the first three corners of
+// a face count.
+static void scanObj(const char *begin, const char *end, const char *fileEnd, ObjChunk &chunk) {
+    const char *p = begin;
+    while (p < end) {
+        const char *line = skipBlanks(p, fileEnd);
+        const char *next = (const char *)memchr(line, '\n', fileEnd - line);
+        next = next != nullptr ? next : fileEnd;
+        p = next + 1;
+        if (next - line < 3 || *line == '#') {
+            continue;
+        }
+        const char *q = line + 1;
+        char kind = *line == 'v' && !isBlank(*q) ? *q++ : *line;
+        if (!isBlank(*q)) {
+            continue;
+        }
+        if (*line == 'v') {
+            float x[3] = {0, 0, 0};
+            int n = kind == 't' ? 2 : 3;
+            for (int k = 0; k < n && q != nullptr; ++k) {
+                q = scanFloat(skipBlanks(q, next), next, x[k]);
+            }
+            if (kind == 'v') {
+                chunk.v.push_back(Vector3f(x[0], x[1], x[2]));
+            } else if (kind == 't') {
+                chunk.vt.push_back(Vector2f(x[0], x[1]));
+            } else if (kind == 'n') {
+                chunk.vn.push_back(Vector3f(x[0], x[1], x[2]));
+            }
+        } else if (*line == 'f') {
+            Mesh::TriangleIndex trig, tex, nor;
+            for (int i = 0; i < 3 && q != nullptr; ++i) {
+                int index;
+                q = scanInt(skipBlanks(q, next), next, index);
+                if (q == nullptr) {
+                    break;
+                }
+                trig[i] = index - 1;
+                if (q < next && *q == '/') {
+                    const char *after = scanInt(++q, next, index);
+                    if (after != nullptr) {
+                        tex[i] = index - 1;
+                        q = after;
+                    }
+                    if (q < next && *q == '/') {
+                        after = scanInt(++q, next, index);
+                        if (after != nullptr) {
+                            nor[i] = index - 1;
+                            q = after;
+                        }
+                    }
+                }
+                // Skip whatever else the corner carries.
+                while (q < next && !isBlank(*q)) {
+                    ++q;
+                }
+            }
+            if (q == nullptr) {
+                continue;
+            }
+            chunk.t.push_back(trig);
+            chunk.text.push_back(tex);
+            chunk.norm.push_back(nor);
+        }
+    }
+}
+
+// Appends the chunks' lists in order, each chunk copying into its own range.
+template <class T>
+static void join(vector<ObjChunk> &chunks, vector<T> ObjChunk::*list, vector<T> &out) {
+    int n = chunks.size();
+    vector<size_t> start(n + 1, 0);
+    for (int c = 0; c < n; ++c) {
+        start[c + 1] = start[c] + (chunks[c].*list).size();
+    }
+    out.resize(start[n]);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n; ++c) {
+        copy((chunks[c].*list).begin(), (chunks[c].*list).end(), out.begin() + start[c]);
+        vector<T>().swap(chunks[c].*list);
+    }
+}
+
+static const char meshMagic[4] = {'M', 'S', 'H', '\0'};
+static const int meshVersion = 1;
+
+Mesh::Mesh(const char *filename, Material *material) : Object3D(material), tree(), area(0) {
+    double start = omp_get_wtime();
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         std::cout << "Cannot open " << filename << "\n";
         return;
     }
-    std::string line;
-    std::string vTok("v");
-    std::string fTok("f");
-    std::string texTok("vt"); 
-    std::string normTok("vn");
-    char bslash = '/';
-    std::string tok;
+    struct stat st;
+    fstat(fd, &st);
+    uint64_t objSize = st.st_size;
+    int64_t objTime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    std::string cacheName = std::string(filename) + ".cache";
+    if (Option::meshCache && readCache(cacheName.c_str(), objSize, objTime)) {
+        close(fd);
+        finish();
+        fprintf(stderr, "Loaded %s from its cache: %d triangles in %.3f s\n", filename, (int)normals.size(), omp_get_wtime() - start);
+        return;
+    }
+    void *map = objSize > 0 ? mmap(nullptr, objSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::cout << "Cannot open " << filename << "\n";
+        return;
+    }
+    // Chunks of about a megabyte each begin at the first line starting in
+    // their share of the file.
+    const char *data = (const char *)map, *dataEnd = data + objSize;
+    int chunkCount = (int)min<uint64_t>(objSize / (1 << 20) + 1, 1024);
+    vector<const char *> bounds(chunkCount + 1, dataEnd);
+    for (int c = 0; c < chunkCount; ++c) {
+        const char *p = data + objSize * c / chunkCount;
+        if (c > 0) {
+            const char *newline = (const char *)memchr(p - 1, '\n', dataEnd - (p - 1));
+            p = newline != nullptr ? newline + 1 : dataEnd;
+        }
+        bounds[c] = p;
+    }
+    vector<ObjChunk> chunks(chunkCount);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < chunkCount; ++c) {
+        scanObj(bounds[c], bounds[c + 1], dataEnd, chunks[c]);
+    }
+    munmap(map, objSize);
     std::vector<Vector3f> v;
     std::vector<TriangleIndex> t, text, norm;
     std::vector<Vector2f> vt;
     std::vector<Vector3f> vn;
-    while (true) {
-        std::getline(f, line);
-        if (f.eof()) {
-            break;
+    join(chunks, &ObjChunk::v, v);
+    join(chunks, &ObjChunk::vt, vt);
+    join(chunks, &ObjChunk::vn, vn);
+    join(chunks, &ObjChunk::t, t);
+    join(chunks, &ObjChunk::text, text);
+    join(chunks, &ObjChunk::norm, norm);
+    int size = t.size();
+    positions.resize(size * 3);
+    edges.resize(size * 6);
+    normals.resize(size);
+    std::vector<BVHBox> boxes(size);
+#pragma omp parallel for
+    for (int triId = 0; triId < size; ++triId) {
+        TriangleIndex &idx = t[triId];
+        const Vector3f &a = v[idx[0]], &b = v[idx[1]], &c = v[idx[2]];
+        Vector3f e1 = b - a, e2 = c - a;
+        for (int k = 0; k < 3; ++k) {
+            positions[triId * 3 + k] = a[k];
+            edges[triId * 6 + k] = e1[k];
+            edges[triId * 6 + 3 + k] = e2[k];
         }
-        if (line.size() < 3) {
+        normals[triId] = Vector3f::cross(e1, e2).normalized();
+        boxes[triId] = BVHBox(Utils::min(Utils::min(a, b), c), Utils::max(Utils::max(a, b), c));
+    }
+    tree.construct(boxes);
+    // Store triangles in leaf order so that a leaf reads contiguous memory.
+    std::vector<int> order = tree.releaseOrder();
+    std::vector<float> sortedPositions(size * 3), sortedEdges(size * 6);
+    std::vector<Vector3f> sortedNormals(size);
+    textureIndices.resize(size);
+    normalIndices.resize(size);
+#pragma omp parallel for
+    for (int i = 0; i < size; ++i) {
+        int triId = order[i];
+        std::copy(&positions[triId * 3], &positions[triId * 3] + 3, &sortedPositions[i * 3]);
+        std::copy(&edges[triId * 6], &edges[triId * 6] + 6, &sortedEdges[i * 6]);
+        sortedNormals[i] = normals[triId];
+        textureIndices[i] = text[triId];
+        normalIndices[i] = norm[triId];
+    }
+    positions.swap(sortedPositions);
+    edges.swap(sortedEdges);
+    normals.swap(sortedNormals);
+    textures.swap(vt);
+    vertexNormals.swap(vn);
+    finish();
+    if (Option::meshCache) {
+        saveCache(cacheName.c_str(), objSize, objTime);
+    }
+    fprintf(stderr, "Loaded %s: %d triangles in %.3f s\n", filename, size, omp_get_wtime() - start);
+}
+
+void Mesh::finish() {
+    int size = normals.size();
+    std::vector<float> areas(size);
+    area = 0;
+    for (int i = 0; i < size; ++i) {
+        const float *e1 = &edges[i * 6], *e2 = &edges[i * 6 + 3];
+        areas[i] = Vector3f::cross(Vector3f(e1[0], e1[1], e1[2]), Vector3f(e2[0], e2[1], e2[2])).length() / 2;
+        area += areas[i];
+    }
+    triangleTable.build(areas);
+    setBound(tree.getKonta(), tree.getMakria());
+}
+
+static_assert(sizeof(Vector3f) == 3 * sizeof(float) && sizeof(Vector2f) == 2 * sizeof(float) && sizeof(Mesh::TriangleIndex) == 3 * sizeof(int), "cached arrays are stored packed");
+
+// Copies count elements of a cached array into a buffer and moves on.
+template <class T>
+static void readArray(const char *&p, size_t count, std::vector<T> &out) {
+    out.resize(count);
+    memcpy((void *)out.data(), p, count * sizeof(T));
+    p += count * sizeof(T);
+}
+
+// Every index of a cached triangle list is either absent (-1 in its first
+// corner) or inside a list of count entries.
+static bool validIndices(const Mesh::TriangleIndex *indices, int n, int count) {
+    for (int i = 0; i < n; ++i) {
+        if (indices[i][0] < 0) {
             continue;
         }
-        if (line.at(0) == '#') {
-            continue;
+        for (int k = 0; k < 3; ++k) {
+            if (indices[i][k] < 0 || indices[i][k] >= count) {
+                return false;
+            }
         }
-        std::stringstream ss(line);
-        ss >> tok;
-        if (tok == vTok) {
-            Vector3f vec;
-            ss >> vec[0] >> vec[1] >> vec[2];
-            v.push_back(vec);
-        } else if (tok == fTok) {
-            TriangleIndex trig, tex, nor;
-            for (int i = 0; i < 3; ++i) {
-                std::string face;
-                std::vector<std::string> res;
-                ss >> face;
-                Utils::stringSplit(face, bslash, res);
-                trig[i] = stoi(res[0]) - 1;
-                if (res.size() > 1 && res[1] != "") {
-                    tex[i] = stoi(res[1]) - 1;
-                }
-                if (res.size() > 2 && res[2] != "") {
-                    nor[i] = stoi(res[2]) - 1;
-                }
+    }
+    return true;
+}
+
+// Cached BVH4 nodes form a tree over the triangles: each child is a later
+// node, so traversal cannot loop, or a leaf within the triangles.
+static bool validNodes(const BVH4Node *nodes, int count, int triangles) {
+    if (count == 0 && triangles > 0) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        const BVH4Node &node = nodes[i];
+        if (node.size < 0 || node.size > 4) {
+            return false;
+        }
+        for (int k = 0; k < node.size; ++k) {
+            int child = node.child[k];
+            if (child >= 0 ? child <= i || child >= count : (~child >> 5) + (~child & 31) > triangles) {
+                return false;
             }
-            t.push_back(trig);
-            text.push_back(tex);
-            norm.push_back(nor);
-        } else if (tok == texTok) {
-            Vector2f texcoord;
-            ss >> texcoord[0];
-            ss >> texcoord[1];
-            vt.push_back(texcoord);
-        } else if (tok == normTok) {
-            Vector3f norcoord;
-            ss >> norcoord[0] >> norcoord[1] >> norcoord[2];
-            vn.push_back(norcoord);
-        }
-    }
-
-    f.close();
-    for (int triId = 0; triId < (int)t.size(); ++triId) {
-        TriangleIndex &idx = t[triId];
-        Triangle *tria = new Triangle(v[idx[0]], v[idx[1]], v[idx[2]], material);
-        if (text[triId][0] >= 0) {
-            tria->setTextures(vt[text[triId][0]], vt[text[triId][1]], vt[text[triId][2]]);
         }
-        if (norm[triId][0] >= 0) {
-            tria->setNormals(vn[norm[triId][0]], vn[norm[triId][1]], vn[norm[triId][2]]);
+    }
+    return true;
+}
+
+template <class T>
+static void writeArray(FILE *file, const std::vector<T> &in, bool &ok) {
+    ok = ok && (in.empty() || fwrite(in.data(), sizeof(T), in.size(), file) == in.size());
+}
+
+bool Mesh::readCache(const char *filename, uint64_t objSize, int64_t objTime) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = st.st_size;
+    void *map = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    const MeshCacheHeader *header = (const MeshCacheHeader *)map;
+    bool valid = size >= sizeof(MeshCacheHeader) && !memcmp(header->magic, meshMagic, 4) && header->version == meshVersion &&
+        header->objSize == objSize && header->objTime == objTime && header->sah == Option::sah &&
+        header->triangles >= 0 && header->textures >= 0 && header->vertexNormals >= 0 && header->nodes >= 0 &&
+        size == sizeof(MeshCacheHeader) + (size_t)header->triangles * (12 * sizeof(float) + 6 * sizeof(int)) +
+        (size_t)header->textures * sizeof(Vector2f) + (size_t)header->vertexNormals * sizeof(Vector3f) + (size_t)header->nodes * sizeof(BVH4Node);
+    // A cache of the right size can still be corrupt; its indices are
+    // checked before traversal or shading trusts them.
+    if (valid) {
+        int n = header->triangles;
+        const char *indices = (const char *)(header + 1) + (size_t)n * 12 * sizeof(float);
+        const char *nodes = indices + (size_t)n * 6 * sizeof(int) + (size_t)header->textures * sizeof(Vector2f) +
+            (size_t)header->vertexNormals * sizeof(Vector3f);
+        valid = validIndices((const TriangleIndex *)indices, n, header->textures) &&
+            validIndices((const TriangleIndex *)indices + n, n, header->vertexNormals) &&
+            validNodes((const BVH4Node *)nodes, header->nodes, n);
+    }
+    if (valid) {
+        int n = header->triangles;
+        const char *p = (const char *)(header + 1);
+        readArray(p, n * 3, positions);
+        readArray(p, n * 6, edges);
+        readArray(p, n, normals);
+        readArray(p, n, textureIndices);
+        readArray(p, n, normalIndices);
+        readArray(p, header->textures, textures);
+        readArray(p, header->vertexNormals, vertexNormals);
+        BVHBox bounds;
+        for (int k = 0; k < 3; ++k) {
+            bounds.konta[k] = header->konta[k];
+            bounds.makria[k] = header->makria[k];
         }
-        patches.push_back(tria);
+        tree.load((const BVH4Node *)p, header->nodes, bounds, n);
+    }
+    munmap(map, size);
+    return valid;
+}
+
+// Writes to a temporary name first, so an interrupted write never leaves a
+// cache that looks valid.
+void Mesh::saveCache(const char *filename, uint64_t objSize, int64_t objTime) const {
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, meshMagic, 4);
+    header.version = meshVersion;
+    header.triangles = normals.size();
+    header.textures = textures.size();
+    header.vertexNormals = vertexNormals.size();
+    header.nodes = tree.getNodes().size();
+    header.sah = Option::sah;
+    header.objSize = objSize;
+    header.objTime = objTime;
+    for (int k = 0; k < 3; ++k) {
+        header.konta[k] = tree.getBounds().konta[k];
+        header.makria[k] = tree.getBounds().makria[k];
+    }
+    std::string temporary = std::string(filename) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    bool ok = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1;
+    writeArray(file, positions, ok);
+    writeArray(file, edges, ok);
+    writeArray(file, normals, ok);
+    writeArray(file, textureIndices, ok);
+    writeArray(file, normalIndices, ok);
+    writeArray(file, textures, ok);
+    writeArray(file, vertexNormals, ok);
+    writeArray(file, tree.getNodes(), ok);
+    if (file != NULL) {
+        ok = fclose(file) == 0 && ok;
+    }
+    if (!ok || rename(temporary.c_str(), filename) != 0) {
+        fprintf(stderr, "Cannot write file: %s\n", filename);
+        remove(temporary.c_str());
     }
-    tree.construct(patches);
-    setBound(tree.getKonta(), tree.getMakria());
 }
 
 Ray Mesh::generateBeam(float time) const {
-    int which = Utils::randomEngine() * patches.size();
-    return patches[which]->generateBeam(time);
-}
\ No newline at end of file
+    int which = triangleTable.sample(Utils::randomEngine());
+    float rb = Utils::randomEngine(), rc = Utils::randomEngine();
+    if (rb + rc > 1) {
+        rb = 1 - rb;
+        rc = 1 - rc;
+    }
+    const float *v0 = &positions[which * 3], *e1 = &edges[which * 6], *e2 = &edges[which * 6 + 3];
+    Vector3f point(v0[0] + rb * e1[0] + rc * e2[0], v0[1] + rb * e1[1] + rc * e2[1], v0[2] + rb * e1[2] + rc * e2[2]);
+    return Ray(point, Utils::sampleReflectedRay(normals[which]), time);
+}
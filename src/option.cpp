@@ -0,0 +1,10 @@
+#include "option.hpp"
+
+bool Option::sah = true;
+bool Option::hashGrid = true;
+float Option::adaptive = 0;
+int Option::tileSize = 16;
+Option::TileOrder Option::tileOrder = Option::hilbertOrder;
+int Option::packetSize = 16;
+bool Option::wavefront = false;
+bool Option::meshCache = false;
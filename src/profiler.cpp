@@ -0,0 +1,7 @@
+#include "profiler.hpp"
+
+bool Profiler::enabled = false;
+const char *Profiler::logName = nullptr;
+vector<Profiler::Slot> Profiler::slots;
+Profiler::Record Profiler::current;
+vector<Profiler::Record> Profiler::records;
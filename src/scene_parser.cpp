@@ -73,6 +73,12 @@ SceneParser::~SceneParser() {
         delete lights[i];
     }
     delete[] lights;
+    for (auto &mesh : meshes) {
+        delete mesh.second;
+    }
+    for (auto &texture : textures) {
+        delete texture.second;
+    }
 }
 
 // ====================================================================
@@ -284,10 +290,10 @@ Material *SceneParser::parseMaterial() {
         } else if (strcmp(token, "texture") == 0) {
             // Optional: read in texture and draw it.
             getToken(filename);
-            texture = new Texture(filename);
+            texture = loadTexture(filename);
         } else if (strcmp(token, "normal") == 0) {
             getToken(filename);
-            normal = new Texture(filename);
+            normal = loadTexture(filename);
         } else if (strcmp(token, "prop") == 0) {
             getToken(distribution);
             prop = Distribution::getProperties(distribution);
@@ -301,6 +307,14 @@ Material *SceneParser::parseMaterial() {
     return answer;
 }
 
+Texture *SceneParser::loadTexture(const char *filename) {
+    Texture *&texture = textures[filename];
+    if (texture == nullptr) {
+        texture = new Texture(filename);
+    }
+    return texture;
+}
+
 // ====================================================================
 // ====================================================================
 
@@ -321,7 +335,7 @@ Object3D *SceneParser::parseObject(char token[MAX_PARSER_TOKEN_LENGTH]) {
     } else if (!strcmp(token, "TriangleMesh")) {
         answer = (Object3D *) parseTriangleMesh();
     } else if (!strcmp(token, "Transform")) {
-        answer = (Object3D *) parseTransform();
+        answer = parseTransform();
     } else if (!strcmp(token, "BezierCurve")) {
         answer = (Object3D *) parseBezierCurve();
     } else if (!strcmp(token, "BsplineCurve")) {
@@ -496,8 +510,10 @@ Mesh *SceneParser::parseTriangleMesh() {
     assert (!strcmp(token, "}"));
     const char *ext = &filename[strlen(filename) - 4];
     assert(!strcmp(ext, ".obj"));
-    Mesh *answer = new Mesh(filename, current_material);
-
+    Mesh *&answer = meshes[std::make_pair(std::string(filename), current_material)];
+    if (answer == nullptr) {
+        answer = new Mesh(filename, current_material);
+    }
     return answer;
 }
 
@@ -573,7 +589,7 @@ RevSurface *SceneParser::parseRevSurface() {
 }
 
 
-Transform *SceneParser::parseTransform() {
+Object3D *SceneParser::parseTransform() {
     char token[MAX_PARSER_TOKEN_LENGTH];
     Matrix4f matrix = Matrix4f::identity();
     Object3D *object = nullptr;
@@ -633,6 +649,31 @@ Transform *SceneParser::parseTransform() {
     assert(object != nullptr);
     getToken(token);
     assert (!strcmp(token, "}"));
+    return flatten(matrix, object);
+}
+
+// Folds a transform into what it wraps where that is exact: nested
+// transforms compose into one, and a sphere only moved and uniformly scaled
+// becomes a sphere in world space, which can also be sampled as a light.
+Object3D *SceneParser::flatten(const Matrix4f &matrix, Object3D *object) {
+    if (Transform *inner = dynamic_cast<Transform *>(object)) {
+        Object3D *answer = flatten(matrix * inner->getMatrix(), inner->getObject());
+        delete inner;
+        return answer;
+    }
+    Sphere *sphere = dynamic_cast<Sphere *>(object);
+    float scale = matrix(0, 0);
+    bool similar = scale > 0 && matrix(3, 3) == 1;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            similar = similar && matrix(i, j) == (i == j ? scale : 0);
+        }
+    }
+    if (sphere != nullptr && similar) {
+        Object3D *answer = new Sphere(transformPoint(matrix, sphere->getCenter(0)), sphere->getRadius() * scale, sphere->getMaterial());
+        delete sphere;
+        return answer;
+    }
     return new Transform(matrix, object);
 }
 
@@ -0,0 +1,33 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "texture.hpp"
+#include "stb_image.h"
+
+float Texture::unit[256];
+
+Texture::Texture(const char *filename) {
+    int channel;
+    unsigned char *img = stbi_load(filename, &width, &height, &channel, 3);
+    if (img == nullptr) {
+        fprintf(stderr, "Cannot open file: %s\n", filename);
+        exit(1);
+    }
+    for (int i = 0; i < 256; ++i) {
+        unit[i] = i / 255.0;
+    }
+    tilesPerRow = (width + tileSize - 1) / tileSize;
+    int tileRows = (height + tileSize - 1) / tileSize;
+    storage.assign((size_t)tilesPerRow * tileRows * tileSize * tileSize * 4 + 63, 255);
+    texels = (uint8_t *)(((uintptr_t)storage.data() + 63) & ~(uintptr_t)63);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const unsigned char *pixel = img + ((size_t)y * width + x) * 3;
+            uint8_t *texel = texels + texelIndex(x, y) * 4;
+            texel[0] = pixel[0];
+            texel[1] = pixel[1];
+            texel[2] = pixel[2];
+        }
+    }
+    stbi_image_free(img);
+}